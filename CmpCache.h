@@ -3,6 +3,11 @@
 // Description:
 //    Defines a simple cache component. The cache has a single bank and a single
 //    read-write port. Policy is specified using one of the table policies.
+//    Prefetches fill the cache according to their fill level: low priority
+//    prefetches are inserted with POLICY_LOW (which needs a policy that
+//    honors it, like dip), and llc prefetches fill it only as a last-level
+//    cache. As a last-level cache, it also reports the blocks evicted by
+//    prefetches and the demand misses to the prefetch feedback controller.
 // -----------------------------------------------------------------------------
 
 #ifndef __CMP_CACHE_H__
@@ -16,6 +21,8 @@
 // All components inherit from MemoryComponent
 #include "MemoryComponent.h"
 #include "GenericTagStore.h"
+#include "PrefetchFeedback.h"
+#include "PrefetchMonitor.h"
 #include "Types.h"
 
 // -----------------------------------------------------------------------------
@@ -50,6 +57,10 @@ protected:
 
   bool _evictionLog;					// whether eviciton data is to be stored
   bool _exclusive;
+  bool _lastLevel;
+
+  uint32 _prefetchVictims;
+  uint32 _prefetchTrace;
 
   // -------------------------------------------------------------------------
   // Private members
@@ -60,6 +71,7 @@ protected:
     addr_t vcla;
     addr_t pcla;
     uint32 reuse;
+    prefetch_line_t prefetch;
     CacheTagValue() { dirty = false; reuse = 0; }
   };
 
@@ -80,6 +92,9 @@ protected:
   map <addr_t, EvictionData> _evictionData;
   map <uint32, uint64> _reuse;
 
+  // per prefetcher statistics
+  prefetch_monitor_t _prefetchMonitor;
+
 
   // -------------------------------------------------------------------------
   // Declare counters
@@ -95,6 +110,7 @@ protected:
   NEW_COUNTER(writemisses);
   NEW_COUNTER(evictions);
   NEW_COUNTER(dirtyevictions);
+  NEW_COUNTER(prefetch_bypasses);
 
 public:
 
@@ -113,6 +129,9 @@ public:
     _serialLookup = false;
     _evictionLog = false;
     _exclusive = false;
+    _lastLevel = false;
+    _prefetchVictims = 1024;
+    _prefetchTrace = 0;
   }
 
 
@@ -139,6 +158,9 @@ public:
       CMP_PARAMETER_BOOLEAN("serial-lookup", _serialLookup)
       CMP_PARAMETER_BOOLEAN("eviction-log", _evictionLog)
       CMP_PARAMETER_BOOLEAN("exclusive", _exclusive)
+      CMP_PARAMETER_BOOLEAN("last-level", _lastLevel)
+      CMP_PARAMETER_UINT("prefetch-victims", _prefetchVictims)
+      CMP_PARAMETER_UINT("prefetch-trace", _prefetchTrace)
 
     CMP_PARAMETER_END
   }
@@ -161,6 +183,7 @@ public:
     INITIALIZE_COUNTER(writemisses, "Write Misses");
     INITIALIZE_COUNTER(evictions, "Evictions");
     INITIALIZE_COUNTER(dirtyevictions, "Dirty Evictions");
+    INITIALIZE_COUNTER(prefetch_bypasses, "Prefetches Not Filled");
   }
 
 
@@ -172,6 +195,24 @@ public:
     // compute the number of sets and initialize the tag store
     _numSets = _size / (_blockSize * _associativity);
     _tags.SetTagStoreParameters(_numSets, _associativity, _policy);
+
+    _prefetchMonitor.SetVictims(_prefetchVictims);
+    if (_prefetchTrace != 0) {
+      NEW_LOG_FILE("prefetches", "prefetches.csv");
+      LOG("prefetches", "block,prefetcher,id,issue,fill,use,evict\n");
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // End warm up
+  // -------------------------------------------------------------------------
+
+  void EndWarmUp() {
+    MemoryComponent::EndWarmUp();
+    _prefetchMonitor.Reset();
+    if (_prefetchTrace != 0)
+      _prefetchMonitor.SetTrace(_logs["prefetches"], _prefetchTrace);
   }
 
     
@@ -182,6 +223,15 @@ public:
 
   void EndSimulation() {
     DUMP_STATISTICS;
+    _prefetchMonitor.Dump(_simulationLog, _name);
+    for (uint32 i = 0; i < _numSets; i ++) {
+      for (uint32 j = 0; j < _associativity; j ++) {
+        table_t <addr_t, CacheTagValue>::entry tagentry =
+          _tags.entry_at_location(i, j);
+        if (tagentry.valid)
+          _prefetchMonitor.Resident(tagentry.value.prefetch, tagentry.key);
+      }
+    }
     if (_evictionLog) {
       string filename = _simulationFolderName + "/" + _name + ".eviction";
       FILE *file;
@@ -210,6 +260,93 @@ public:
       }
       fclose(file);
     }
+    CLOSE_ALL_LOGS;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functional path. Updates the tags and the replacement state like
+  // ProcessRequest and ProcessReturn, without latency or statistics
+  // -------------------------------------------------------------------------
+
+  bool WarmAccess(MemoryRequest *request) {
+
+    addr_t ctag = (_virtualTag ? (request -> virtualAddress) : 
+                   (request -> physicalAddress)) / _blockSize;
+
+    table_t <addr_t, CacheTagValue>::entry tagentry;
+
+    if (request -> type == MemoryRequest::PARTIALWRITE &&
+        request -> size == _blockSize) {
+      request -> type = MemoryRequest::WRITEBACK;
+    }
+    else if (request -> type == MemoryRequest::WRITEBACK &&
+             request -> size < _blockSize) {
+      request -> type = MemoryRequest::PARTIALWRITE;
+    }
+
+    switch (request -> type) {
+
+    case MemoryRequest::READ:
+    case MemoryRequest::READ_FOR_WRITE:
+    case MemoryRequest::PREFETCH:
+      return _tags.read(ctag).valid;
+
+    case MemoryRequest::WRITE:
+      tagentry = _tags.silentupdate(ctag);
+      if (tagentry.valid)
+        _tags[ctag].dirty = true;
+      return tagentry.valid;
+
+    case MemoryRequest::PARTIALWRITE:
+      tagentry = _tags.read(ctag);
+      if (tagentry.valid)
+        _tags[ctag].dirty = true;
+      return tagentry.valid;
+
+    case MemoryRequest::WRITEBACK:
+      if (_tags.lookup(ctag)) {
+        _tags[ctag].dirty = true;
+      }
+      else {
+        tagentry = _tags.insert(ctag, CacheTagValue());
+        _tags[ctag].dirty = true;
+        _tags[ctag].vcla = ((request -> virtualAddress)/_blockSize)*_blockSize;
+        _tags[ctag].pcla = ((request -> physicalAddress)/_blockSize)*_blockSize;
+        WarmEvictBlock(tagentry, request);
+      }
+      return true;
+    }
+
+    return false;
+  }
+
+
+  void WarmReturn(MemoryRequest *request) {
+
+    addr_t ctag = (_virtualTag ? request -> virtualAddress : 
+                   request -> physicalAddress) / _blockSize;
+
+    if (_tags.lookup(ctag))
+      return;
+
+    policy_value_t pval;
+    if (!Fills(request, pval))
+      return;
+
+    table_t <addr_t, CacheTagValue>::entry tagentry;
+
+    tagentry = _tags.insert(ctag, CacheTagValue(), pval);
+    _tags[ctag].vcla = ((request -> virtualAddress) / _blockSize) * _blockSize;
+    _tags[ctag].pcla = ((request -> physicalAddress) / _blockSize) * _blockSize;
+    if (request -> type == MemoryRequest::WRITE || 
+        request -> type == MemoryRequest::PARTIALWRITE ||
+        request -> dirtyReply)
+      _tags[ctag].dirty = true;
+
+    request -> dirtyReply = false;
+
+    WarmEvictBlock(tagentry, request);
   }
 
 protected:
@@ -267,11 +404,15 @@ protected:
           _dataStoreLatency;
         _tags[ctag].reuse ++;
         request -> serviced = true;
+        if (request -> type != MemoryRequest::PREFETCH)
+          _prefetchMonitor.Use(_tags[ctag].prefetch, request -> currentCycle);
       }
       else {
         INCREMENT(misses);
         INCREMENT(readmisses);
         latency = _tagStoreLatency;
+        if (request -> type != MemoryRequest::PREFETCH && !request -> metadata)
+          DemandMiss(ctag);
       }
 
       request -> AddLatency(latency);
@@ -293,10 +434,12 @@ protected:
       if (tagentry.valid) {
         _tags[ctag].dirty = true;
         request -> serviced = true;
+        _prefetchMonitor.Use(_tags[ctag].prefetch, request -> currentCycle);
       }
       else {
         INCREMENT(misses);
         INCREMENT(writemisses);
+        DemandMiss(ctag);
       }
       return _tagStoreLatency;
 	// in write, add latency for only the tagstore (stalling for tag), but no latency for datawrite, as it is hidden 
@@ -321,11 +464,13 @@ protected:
         latency = (_serialLookup ? _tagStoreLatency : 0) + 
           _dataStoreLatency;
         request -> serviced = true;
+        _prefetchMonitor.Use(_tags[ctag].prefetch, request -> currentCycle);
       }
       else {
         INCREMENT(misses);
         INCREMENT(writemisses);
         latency = _tagStoreLatency;
+        DemandMiss(ctag);
       }
 
       request -> AddLatency(latency);
@@ -378,14 +523,25 @@ protected:
     addr_t ctag = (_virtualTag ? request -> virtualAddress : 
                    request -> physicalAddress) / _blockSize;
 
-    // else check if the block is already present in the cache
-    if (_tags.lookup(ctag))
+    // else check if the block is already present in the cache. A demand
+    // that finds a prefetched block waited for the prefetch
+    if (_tags.lookup(ctag)) {
+      if (request -> type != MemoryRequest::PREFETCH)
+        _prefetchMonitor.Merged(_tags[ctag].prefetch, request -> currentCycle);
       return 0;
+    }
+
+    // a prefetch may not be placed at this level
+    policy_value_t pval;
+    if (!Fills(request, pval)) {
+      INCREMENT(prefetch_bypasses);
+      return 0;
+    }
 
     table_t <addr_t, CacheTagValue>::entry tagentry;
 
     // else insert the block into the cache
-    tagentry = _tags.insert(ctag, CacheTagValue());
+    tagentry = _tags.insert(ctag, CacheTagValue(), pval);
     _tags[ctag].vcla = ((request -> virtualAddress) / _blockSize) * _blockSize;
     _tags[ctag].pcla = ((request -> physicalAddress) / _blockSize) * _blockSize;
     if (request -> type == MemoryRequest::WRITE || 
@@ -396,11 +552,48 @@ protected:
     // Need to clean this up
     request -> dirtyReply = false;
 
+    _prefetchMonitor.Fill(_tags[ctag].prefetch, request);
     EvictBlock(tagentry, request);
     return 0;
   }
 
 
+  // -------------------------------------------------------------------------
+  // Function to check if a returning request fills the cache, and the
+  // priority of the fill
+  // -------------------------------------------------------------------------
+
+  bool Fills(MemoryRequest *request, policy_value_t &pval) {
+    pval = POLICY_HIGH;
+    if (request -> type != MemoryRequest::PREFETCH)
+      return true;
+
+    switch (request -> fillLevel) {
+    case MemoryRequest::FILL_ALL:
+      return true;
+    case MemoryRequest::FILL_LLC:
+      return _lastLevel;
+    case MemoryRequest::FILL_LOW:
+      if (!_lastLevel) pval = POLICY_LOW;
+      return true;
+    case MemoryRequest::FILL_BUFFER:
+      return false;
+    }
+    return true;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to record a demand miss
+  // -------------------------------------------------------------------------
+
+  void DemandMiss(addr_t ctag) {
+    _prefetchMonitor.DemandMiss(ctag);
+    if (_lastLevel)
+      PrefetchFeedback().DemandMiss(ctag);
+  }
+
+
   // -------------------------------------------------------------------------
   // Function to evict a tag entry
   // This function will collect stats related to the eviction and then
@@ -419,6 +612,9 @@ protected:
         _reuse[tagentry.value.reuse] ++;
       }
       INCREMENT(evictions);
+      _prefetchMonitor.Evict(tagentry.value.prefetch, tagentry.key, request);
+      if (_lastLevel && request -> type == MemoryRequest::PREFETCH)
+        PrefetchFeedback().Evicted(request -> prefetcher, tagentry.key);
       if (tagentry.value.dirty) {
         if (_evictionLog) {
           _evictionData[tagentry.key].dirty ++;
@@ -447,6 +643,18 @@ protected:
       }
     }
   }
+
+
+  // -------------------------------------------------------------------------
+  // Function to evict a tag entry on the functional path
+  // -------------------------------------------------------------------------
+
+  void WarmEvictBlock(table_t <addr_t, CacheTagValue>::entry tagentry,
+                      MemoryRequest *request) {
+    if (tagentry.valid && (tagentry.value.dirty || _exclusive))
+      WarmWriteback(request, tagentry.value.vcla, tagentry.value.pcla,
+                    _blockSize, tagentry.value.dirty);
+  }
 };
 
 #endif // __CMP_CACHE_H__
@@ -36,6 +36,7 @@
 // -----------------------------------------------------------------------------
 
 #include "MemoryComponent.h"
+#include "Histogram.h"
 #include "Types.h"
 #include <DRAMSim.h>
 
@@ -81,6 +82,7 @@ protected:
 
   uint32 _numWriteBufferEntries;
   uint32 _busProcessorRatio;
+  bool _latencyHistogram;
   
   uint32 _dummy;
 
@@ -118,6 +120,19 @@ protected:
   // number of requests pending
   unsigned pendingRequests;
 
+  // per processor read latency distribution (issue to return)
+  vector <log_histogram_t> _readLatency;
+
+  // energy (nJ) from the DRAMSim power reports. DRAMSim reports the average
+  // power (W) of each rank over an epoch
+  double _cpuCycleTime;
+  cycles_t _powerReportCycle;
+  cycles_t _powerEpoch;
+  double _energyBackground;
+  double _energyBurst;
+  double _energyRefresh;
+  double _energyActivate;
+
 
   // -------------------------------------------------------------------------
   // Declare counters
@@ -152,6 +167,7 @@ public:
     _numWriteBufferEntries = 64;
     _busProcessorRatio = 8;
     _schedAlgo = "fcfs";
+    _latencyHistogram = false;
   }
 
 
@@ -204,6 +220,8 @@ public:
 			pendingRequests--;
 			
 			tempReq -> AddLatency((clock_cycle*_busProcessorRatio) - (tempReq -> currentCycle));
+			if (tempReq -> type != MemoryRequest::PREFETCH)
+			  _readLatency[tempReq -> cpuID].add(tempReq -> currentCycle - tempReq -> issueCycle);
 			tempReq -> cmpID --;
 			((*_hier)[tempReq -> cpuID])[tempReq -> cmpID] -> SimpleAddRequest(tempReq);
 			return;
@@ -259,10 +277,32 @@ public:
 
 	}
 
-	/* This currently does nothing */
-	void power_callback(double a, double b, double c, double d)
+	void power_callback(double background, double burst, double refresh, double actpre)
 	{
-	//	printf("power callback: %0.3f, %0.3f, %0.3f, %0.3f\n",a,b,c,d);
+	// ranks report one after the other at the end of an epoch
+	if (DRAMtime != _powerReportCycle) {
+	  _powerEpoch = DRAMtime - _powerReportCycle;
+	  _powerReportCycle = DRAMtime;
+	}
+	double ns = _powerEpoch * _cpuCycleTime;
+	_energyBackground += background * ns;
+	_energyBurst += burst * ns;
+	_energyRefresh += refresh * ns;
+	_energyActivate += actpre * ns;
+	}
+
+	// DRAMSim takes a plain function for power reports. It is pointed at
+	// each channel before the channel updates
+	static CmpDRAMSim *& PowerReporter()
+	{
+	static CmpDRAMSim *reporter = NULL;
+	return reporter;
+	}
+
+	static void PowerCallback(double background, double burst, double refresh, double actpre)
+	{
+	if (PowerReporter() != NULL)
+	  PowerReporter() -> power_callback(background, burst, refresh, actpre);
 	}
 
 
@@ -282,6 +322,7 @@ public:
       CMP_PARAMETER_UINT("num-write-buffer-entries", _numWriteBufferEntries)
       CMP_PARAMETER_STRING("scheduling-algo", _schedAlgo)
       CMP_PARAMETER_UINT("bus-processor-ratio", _busProcessorRatio)
+      CMP_PARAMETER_BOOLEAN("latency-histogram", _latencyHistogram)
 
 /*
       CMP_PARAMETER_UINT("row-hit-latency", _rowHitLatency)
@@ -333,6 +374,7 @@ public:
     _drain = false;
     _lastOp = MemoryRequest::READ;
     pendingRequests = 0;
+    _readLatency.resize(_numCPUs);
 
 /*
     _rowHitLatency *= _busProcessorRatio;
@@ -347,11 +389,16 @@ public:
         mem->setCPUClockSpeed(procSpeed);
 	DRAMtime = *_simulatorCycle;
 
+	_cpuCycleTime = 1e9 / procSpeed;
+	_powerReportCycle = DRAMtime;
+	_powerEpoch = 0;
+	_energyBackground = _energyBurst = _energyRefresh = _energyActivate = 0;
+
 	typedef DRAMSim::Callback <CmpDRAMSim, void, uint, uint64_t, uint64_t> dramsim_callback_t;
 	TransactionCompleteCB *read_cb = new dramsim_callback_t(this, &CmpDRAMSim::read_complete);
 	TransactionCompleteCB *write_cb = new dramsim_callback_t(this, &CmpDRAMSim::write_complete);
  
-	mem->RegisterCallbacks(read_cb, write_cb, NULL);
+	mem->RegisterCallbacks(read_cb, write_cb, &CmpDRAMSim::PowerCallback);
 	OutFile.open("output");
   }
 
@@ -365,13 +412,56 @@ public:
   }
 
 
+  void EndWarmUp() {
+    MemoryComponent::EndWarmUp();
+    for (uint32 i = 0; i < _numCPUs; i ++)
+      _readLatency[i].reset();
+    _energyBackground = _energyBurst = _energyRefresh = _energyActivate = 0;
+  }
+
+
   void EndSimulation() {
     DUMP_STATISTICS;
+
+    // final power report covers the last partial epoch
+    PowerReporter() = this;
+    mem->printStats(true);
+    CMP_LOG("energy_activate = %.1lf", _energyActivate);
+    CMP_LOG("energy_burst = %.1lf", _energyBurst);
+    CMP_LOG("energy_refresh = %.1lf", _energyRefresh);
+    CMP_LOG("energy_background = %.1lf", _energyBackground);
+    CMP_LOG("energy_total = %.1lf", _energyActivate + _energyBurst +
+            _energyRefresh + _energyBackground);
+    if (_latencyHistogram) {
+      NEW_LOG_FILE("latency", "latency");
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        CMP_LOG("read_latency_mean-%u = %llu", i, _readLatency[i].mean());
+        CMP_LOG("read_latency_p50-%u = %llu", i, _readLatency[i].percentile(50));
+        CMP_LOG("read_latency_p90-%u = %llu", i, _readLatency[i].percentile(90));
+        CMP_LOG("read_latency_p99-%u = %llu", i, _readLatency[i].percentile(99));
+        CMP_LOG("read_latency_p999-%u = %llu", i,
+                _readLatency[i].percentile(99.9));
+        CMP_LOG("read_latency_max-%u = %llu", i, _readLatency[i].max());
+        char prefix[16];
+        sprintf(prefix, "%u ", i);
+        _readLatency[i].dump(_logs["latency"], prefix);
+      }
+    }
     CLOSE_ALL_LOGS;
     OutFile.close();
   }
 
 
+  // -------------------------------------------------------------------------
+  // Functional path. DRAMSim has no functional interface, so the request is
+  // serviced without touching the DRAM state
+  // -------------------------------------------------------------------------
+
+  bool WarmAccess(MemoryRequest *request) {
+    return true;
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -466,6 +556,8 @@ protected:
   void ProcessPendingRequests() {
 
     
+    // DRAMSim reports power from within update, to this channel
+    PowerReporter() = this;
     while(DRAMtime < *_simulatorCycle){
     DRAMtime++;						// update the DRAM time
     mem->update();						
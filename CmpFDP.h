@@ -338,7 +338,7 @@ protected:
         INCREMENT(misses);
         request -> AddLatency(_tagStoreLatency);
         //_missCounter[index] ++;
-        _procMisses[request -> cpuID] ++;
+        if (!_functional) _procMisses[request -> cpuID] ++;
 
       }
           
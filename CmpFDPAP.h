@@ -344,7 +344,7 @@ protected:
         INCREMENT(misses);
         request -> AddLatency(_tagStoreLatency);
         //        _missCounter[index] ++;
-        _procMisses[request -> cpuID] ++;
+        if (!_functional) _procMisses[request -> cpuID] ++;
 
         if (request -> d_prefetched) {
           AccuracyEntry &accEntry = _accuracyTable[request -> d_prefID];
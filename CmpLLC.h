@@ -1,14 +1,15 @@
 // -----------------------------------------------------------------------------
 // File: CmpLLC.h
 // Description:
-//    Implements a last-level cache
+//    Implements a last-level cache. It reports the blocks evicted by
+//    prefetches and the demand misses to the prefetch feedback controller
 // -----------------------------------------------------------------------------
 
 /*
 It is the job of LLC to generate writebacks with good row buffer locality that are to be sent to the
 memory controller so that it can make use of this locality to avoid turnaround time in the channel (aggressive write back)
-Right now, we assume that  the memory controller does this correctly, if it does not, we will have to look into 
-behaviour of memory controller
+The simple-mc component exploits this locality with scheduling-algo frfcfs-batch, which drains queued writebacks
+as per-row bursts (see write_batches, write_activations and turnarounds_avoided in its statistics)
 */
 
 #ifndef __CMP_LLC_H__
@@ -21,6 +22,8 @@ behaviour of memory controller
 #include "MemoryComponent.h"
 #include "Types.h"
 #include "GenericTagStore.h"
+#include "PrefetchFeedback.h"
+#include "PrefetchMonitor.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -50,6 +53,9 @@ protected:
   uint32 _tagStoreLatency;
   uint32 _dataStoreLatency;
 
+  uint32 _prefetchVictims;
+  uint32 _prefetchTrace;
+
   // -------------------------------------------------------------------------
   // Private members
   // -------------------------------------------------------------------------
@@ -59,6 +65,7 @@ protected:
     addr_t vcla;
     addr_t pcla;
     uint32 appID;
+    prefetch_line_t prefetch;
     TagEntry() { dirty = false; }
   };
 
@@ -71,6 +78,9 @@ protected:
   vector <uint32> _hits;
   vector <uint32> _misses;
 
+  // per prefetcher statistics
+  prefetch_monitor_t _prefetchMonitor;
+
   // -------------------------------------------------------------------------
   // Declare Counters
   // -------------------------------------------------------------------------
@@ -81,6 +91,7 @@ protected:
   NEW_COUNTER(misses);
   NEW_COUNTER(evictions);
   NEW_COUNTER(dirty_evictions);
+  NEW_COUNTER(prefetch_bypasses);
 
 
 public:
@@ -97,6 +108,8 @@ public:
     _dataStoreLatency = 15;
     _policy = "lru";
     _policyVal = 0;
+    _prefetchVictims = 1024;
+    _prefetchTrace = 0;
   }
 
 
@@ -120,6 +133,8 @@ public:
       CMP_PARAMETER_UINT("policy-value", _policyVal)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
+      CMP_PARAMETER_UINT("prefetch-victims", _prefetchVictims)
+      CMP_PARAMETER_UINT("prefetch-trace", _prefetchTrace)
 
     CMP_PARAMETER_END
   }
@@ -137,6 +152,7 @@ public:
     INITIALIZE_COUNTER(misses, "Total Misses");
     INITIALIZE_COUNTER(evictions, "Evictions");
     INITIALIZE_COUNTER(dirty_evictions, "Dirty Evictions");
+    INITIALIZE_COUNTER(prefetch_bypasses, "Prefetches Not Filled");
   }
 
 
@@ -158,6 +174,38 @@ public:
                            
     _hits.resize(_numCPUs, 0);
     _misses.resize(_numCPUs, 0);
+
+    _prefetchMonitor.SetVictims(_prefetchVictims);
+    if (_prefetchTrace != 0) {
+      NEW_LOG_FILE("prefetches", "prefetches.csv");
+      LOG("prefetches", "block,prefetcher,id,issue,fill,use,evict\n");
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions called when warmup and simulation end
+  // -------------------------------------------------------------------------
+
+  void EndWarmUp() {
+    MemoryComponent::EndWarmUp();
+    _prefetchMonitor.Reset();
+    if (_prefetchTrace != 0)
+      _prefetchMonitor.SetTrace(_logs["prefetches"], _prefetchTrace);
+  }
+
+  void EndSimulation() {
+    DUMP_STATISTICS;
+    _prefetchMonitor.Dump(_simulationLog, _name);
+    for (uint32 i = 0; i < _numSets; i ++) {
+      for (uint32 j = 0; j < _associativity; j ++) {
+        table_t <addr_t, TagEntry>::entry tagentry =
+          _tags.entry_at_location(i, j);
+        if (tagentry.valid)
+          _prefetchMonitor.Resident(tagentry.value.prefetch, tagentry.key);
+      }
+    }
+    CLOSE_ALL_LOGS;
   }
 
 
@@ -211,14 +259,26 @@ protected:
         request -> serviced = true;
         request -> AddLatency(_tagStoreLatency + _dataStoreLatency);
 
-        // update per processor counters
-        _hits[request -> cpuID] ++;
+        // update per processor counters. the functional path leaves them
+        // and the prefetch statistics unchanged
+        if (!_functional) {
+          _hits[request -> cpuID] ++;
+          if (request -> type != MemoryRequest::PREFETCH)
+            _prefetchMonitor.Use(_tags[ctag].prefetch, request -> currentCycle);
+        }
       }
       else {
         INCREMENT(misses);
         request -> AddLatency(_tagStoreLatency);
 
-        _misses[request -> cpuID] ++;
+        if (!_functional) {
+          _misses[request -> cpuID] ++;
+          if (request -> type != MemoryRequest::PREFETCH &&
+              !request -> metadata) {
+            _prefetchMonitor.DemandMiss(ctag);
+            PrefetchFeedback().DemandMiss(ctag);
+          }
+        }
       }
           
       return _tagStoreLatency;
@@ -257,9 +317,20 @@ protected:
     // get the cache block tag
     addr_t ctag = VADDR(request) / _blockSize;
 
-    // if the block is already present, return
-    if (_tags.lookup(ctag))
+    // if the block is already present, return. A demand that finds a
+    // prefetched block waited for the prefetch
+    if (_tags.lookup(ctag)) {
+      if (request -> type != MemoryRequest::PREFETCH && !_functional)
+        _prefetchMonitor.Merged(_tags[ctag].prefetch, request -> currentCycle);
       return 0;
+    }
+
+    // prefetches placed in a prefetch buffer do not fill the cache
+    if (request -> type == MemoryRequest::PREFETCH &&
+        request -> fillLevel == MemoryRequest::FILL_BUFFER) {
+      INCREMENT(prefetch_bypasses);
+      return 0;
+    }
 
     INSERT_BLOCK(ctag, false, request);
 
@@ -281,10 +352,17 @@ protected:
     _tags[ctag].pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
     _tags[ctag].dirty = dirty;
     _tags[ctag].appID = request -> cpuID;
+    if (!_functional)
+      _prefetchMonitor.Fill(_tags[ctag].prefetch, request);
 
     // if the evicted tag entry is valid
     if (tagentry.valid) {
       INCREMENT(evictions);
+      if (!_functional) {
+        _prefetchMonitor.Evict(tagentry.value.prefetch, tagentry.key, request);
+        if (request -> type == MemoryRequest::PREFETCH)
+          PrefetchFeedback().Evicted(request -> prefetcher, tagentry.key);
+      }
 
       if (tagentry.value.dirty) {
         INCREMENT(dirty_evictions);
@@ -1,7 +1,10 @@
 // -----------------------------------------------------------------------------
 // File: CmpLLCwPref.h
 // Description:
-//    Implements a last-level cache with prefetch monitors
+//    Implements a last-level cache with prefetch monitors. It reports the
+//    blocks evicted by prefetches and the demand misses to the prefetch
+//    feedback controller, and keeps per-prefetcher statistics in a prefetch
+//    monitor (see PrefetchMonitor.h)
 // -----------------------------------------------------------------------------
 
 #ifndef __CMP_LLC_PREF_H__
@@ -14,6 +17,8 @@
 #include "MemoryComponent.h"
 #include "Types.h"
 #include "GenericTagStore.h"
+#include "PrefetchFeedback.h"
+#include "PrefetchMonitor.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -43,6 +48,9 @@ protected:
   uint32 _tagStoreLatency;
   uint32 _dataStoreLatency;
 
+  uint32 _prefetchVictims;
+  uint32 _prefetchTrace;
+
   // -------------------------------------------------------------------------
   // Private members
   // -------------------------------------------------------------------------
@@ -70,6 +78,9 @@ protected:
     // cycle information
     cycles_t prefetchCycle;
     cycles_t useCycle;
+
+    // prefetch metadata for the monitor
+    prefetch_line_t prefetch;
     
     TagEntry() {
       dirty = false;
@@ -85,6 +96,8 @@ protected:
   vector <uint32> _missCounter;
   vector <uint64> _procMisses;
 
+  prefetch_monitor_t _prefetchMonitor;
+
 
   // -------------------------------------------------------------------------
   // Declare Counters
@@ -94,8 +107,10 @@ protected:
   NEW_COUNTER(reads);
   NEW_COUNTER(writebacks);
   NEW_COUNTER(misses);
+  NEW_COUNTER(metadata_misses);
   NEW_COUNTER(evictions);
   NEW_COUNTER(dirty_evictions);
+  NEW_COUNTER(prefetch_bypasses);
 
   NEW_COUNTER(prefetches);
   NEW_COUNTER(prefetch_misses);
@@ -125,6 +140,8 @@ public:
     _dataStoreLatency = 15;
     _policy = "lru";
     _policyVal = 0;
+    _prefetchVictims = 1024;
+    _prefetchTrace = 0;
   }
 
 
@@ -148,6 +165,8 @@ public:
       CMP_PARAMETER_UINT("policy-value", _policyVal)
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
+      CMP_PARAMETER_UINT("prefetch-victims", _prefetchVictims)
+      CMP_PARAMETER_UINT("prefetch-trace", _prefetchTrace)
 
     CMP_PARAMETER_END
   }
@@ -163,8 +182,10 @@ public:
     INITIALIZE_COUNTER(reads, "Read Accesses")
     INITIALIZE_COUNTER(writebacks, "Writeback Accesses")
     INITIALIZE_COUNTER(misses, "Total Misses")
+    INITIALIZE_COUNTER(metadata_misses, "Prefetcher Metadata Misses")
     INITIALIZE_COUNTER(evictions, "Evictions")
     INITIALIZE_COUNTER(dirty_evictions, "Dirty Evictions")
+    INITIALIZE_COUNTER(prefetch_bypasses, "Prefetches Not Filled")
 
     INITIALIZE_COUNTER(prefetches, "Total prefetches")
     INITIALIZE_COUNTER(prefetch_misses, "Prefetch misses")
@@ -200,6 +221,12 @@ public:
     case 1: _pval = POLICY_BIMODAL; break;
     case 2: _pval = POLICY_LOW; break;
     }
+
+    _prefetchMonitor.SetVictims(_prefetchVictims);
+    if (_prefetchTrace != 0) {
+      NEW_LOG_FILE("prefetches", "prefetches.csv");
+      LOG("prefetches", "block,prefetcher,id,issue,fill,use,evict\n");
+    }
   }
 
 
@@ -211,18 +238,69 @@ public:
   void HeartBeat(cycles_t hbCount) {
   }
 
+  void EndWarmUp() {
+    MemoryComponent::EndWarmUp();
+    _prefetchMonitor.Reset();
+    if (_prefetchTrace != 0)
+      _prefetchMonitor.SetTrace(_logs["prefetches"], _prefetchTrace);
+  }
+
   void EndProcWarmUp(uint32 cpuID) {
     _procMisses[cpuID] = 0;
   }
 
   void EndSimulation() {
     DUMP_STATISTICS;
+    _prefetchMonitor.Dump(_simulationLog, _name);
     for (uint32 i = 0; i < _numCPUs; i ++)
       CMP_LOG("misses-%u = %llu", i, _procMisses[i]);
+    for (uint32 i = 0; i < _numSets; i ++) {
+      for (uint32 j = 0; j < _associativity; j ++) {
+        table_t <addr_t, TagEntry>::entry tagentry =
+          _tags.entry_at_location(i, j);
+        if (tagentry.valid)
+          _prefetchMonitor.Resident(tagentry.value.prefetch, tagentry.key);
+      }
+    }
     CLOSE_ALL_LOGS;
   }
 
 
+  // -------------------------------------------------------------------------
+  // Functional path. Updates the tags and the replacement state without
+  // latency, statistics or prefetch monitoring
+  // -------------------------------------------------------------------------
+
+  bool WarmAccess(MemoryRequest *request) {
+
+    addr_t ctag = VADDR(request) / _blockSize;
+
+    if (request -> type == MemoryRequest::WRITEBACK) {
+      if (_tags.lookup(ctag))
+        _tags[ctag].dirty = true;
+      else
+        WarmInsertBlock(ctag, true, request);
+      return true;
+    }
+
+    if (_tags.lookup(ctag)) {
+      _tags.read(ctag);
+      return true;
+    }
+    return false;
+  }
+
+
+  void WarmReturn(MemoryRequest *request) {
+    addr_t ctag = VADDR(request) / _blockSize;
+    if (request -> type == MemoryRequest::PREFETCH &&
+        request -> fillLevel == MemoryRequest::FILL_BUFFER)
+      return;
+    if (!_tags.lookup(ctag))
+      WarmInsertBlock(ctag, false, request);
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -267,6 +345,7 @@ protected:
         
         // read to update state
         TagEntry &tagentry = _tags[ctag];
+        _prefetchMonitor.Use(tagentry.prefetch, request -> currentCycle);
         
         // check the prefetched state
         switch (tagentry.prefState) {
@@ -296,11 +375,18 @@ protected:
         }
         
       }
+      else if (request -> metadata) {
+        // prefetcher metadata is not a demand
+        INCREMENT(metadata_misses);
+        request -> AddLatency(_tagStoreLatency);
+      }
       else {
         INCREMENT(misses);
         request -> AddLatency(_tagStoreLatency);
         _missCounter[index] ++;
-        if (!_done.test(request -> cpuID)) _procMisses[request -> cpuID] ++;
+        if (!_done[request -> cpuID]) _procMisses[request -> cpuID] ++;
+        PrefetchFeedback().DemandMiss(ctag);
+        _prefetchMonitor.DemandMiss(ctag);
       }
           
       return _tagStoreLatency;
@@ -358,9 +444,21 @@ protected:
     // get the cache block tag
     addr_t ctag = VADDR(request) / _blockSize;
 
-    // if the block is already present, return
-    if (_tags.lookup(ctag))
+    // if the block is already present, return. A demand that finds a
+    // prefetched block waited for the prefetch
+    if (_tags.lookup(ctag)) {
+      if (request -> type == MemoryRequest::READ ||
+          request -> type == MemoryRequest::READ_FOR_WRITE)
+        _prefetchMonitor.Merged(_tags[ctag].prefetch, request -> currentCycle);
       return 0;
+    }
+
+    // prefetches placed in a prefetch buffer do not fill the cache
+    if (request -> type == MemoryRequest::PREFETCH &&
+        request -> fillLevel == MemoryRequest::FILL_BUFFER) {
+      INCREMENT(prefetch_bypasses);
+      return 0;
+    }
 
     INSERT_BLOCK(ctag, false, request);
 
@@ -383,6 +481,7 @@ protected:
     _tags[ctag].dirty = dirty;
     _tags[ctag].appID = request -> cpuID;
     _tags[ctag].prefState = NOT_PREFETCHED;
+    _prefetchMonitor.Fill(_tags[ctag].prefetch, request);
 
     uint32 index = _tags.index(ctag);
 
@@ -397,6 +496,10 @@ protected:
     if (tagentry.valid) {
       INCREMENT(evictions);
 
+      if (request -> type == MemoryRequest::PREFETCH)
+        PrefetchFeedback().Evicted(request -> prefetcher, tagentry.key);
+      _prefetchMonitor.Evict(tagentry.value.prefetch, tagentry.key, request);
+
       // check prefetched state
       switch (tagentry.value.prefState) {
       case PREFETCHED_UNUSED:
@@ -440,6 +543,27 @@ protected:
       }
     }
   }
+
+
+  // -------------------------------------------------------------------------
+  // Function to insert a block into the cache on the functional path
+  // -------------------------------------------------------------------------
+
+  void WarmInsertBlock(addr_t ctag, bool dirty, MemoryRequest *request) {
+
+    table_t <addr_t, TagEntry>::entry tagentry;
+
+    tagentry = _tags.insert(ctag, TagEntry(), _pval);
+    _tags[ctag].vcla = BLOCK_ADDRESS(VADDR(request), _blockSize);
+    _tags[ctag].pcla = BLOCK_ADDRESS(PADDR(request), _blockSize);
+    _tags[ctag].dirty = dirty;
+    _tags[ctag].appID = request -> cpuID;
+    _tags[ctag].prefState = NOT_PREFETCHED;
+
+    if (tagentry.valid && tagentry.value.dirty)
+      WarmWriteback(request, tagentry.value.vcla, tagentry.value.pcla,
+                    _blockSize, true);
+  }
 };
 
 #endif // __CMP_LLC_PREF_H__
@@ -1,6 +1,17 @@
 // -----------------------------------------------------------------------------
 // File: CmpMSHR.h
 // Description:
+//    Defines the miss status holding registers. The MSHRs are a flat array
+//    of entries, found by block address through a small open-addressed
+//    table. Each entry holds its targets (the requests waiting for the
+//    miss) inline, up to targets-per-entry of them (0 for no limit).
+//
+//    Prefetch misses hold at most prefetch-entries entries (0 for no
+//    quota), so the rest are left to demand misses. A prefetch that finds
+//    no entry is dropped (drop-prefetches) instead of waiting, and demands
+//    waiting for an entry go before prefetches. A demand that merges into
+//    an in-flight prefetch miss marks the prefetch late. Dropped
+//    prefetches are reported to the prefetch feedback controller.
 // -----------------------------------------------------------------------------
 
 #ifndef __CMP_MSHR_H__
@@ -11,20 +22,29 @@
 // -----------------------------------------------------------------------------
 
 #include "MemoryComponent.h"
+#include "PrefetchFeedback.h"
 #include "Types.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
 // -----------------------------------------------------------------------------
 
-#include <map>
+#include <vector>
 #include <list>
 
 #define MSHR_STALL_PENALTY 10
 
+// targets held in an entry before it spills into a vector
+#define MSHR_INLINE_TARGETS 4
+
+// entries allocated at a time when the count is unlimited
+#define MSHR_GROW_ENTRIES 64
+
 // -----------------------------------------------------------------------------
 // Class: CmpMSHR
 // Description:
+//    Merges the misses to a block, and bounds the number of outstanding
+//    misses to count (0 for no limit).
 // -----------------------------------------------------------------------------
 
 class CmpMSHR : public MemoryComponent {
@@ -37,15 +57,199 @@ class CmpMSHR : public MemoryComponent {
 
     uint32 _count;
     uint32 _blockSize;
+    uint32 _targetsPerEntry;
+    uint32 _prefetchEntries;
+    bool _dropPrefetches;
 
     // -------------------------------------------------------------------------
     // Private members
     // -------------------------------------------------------------------------
 
-    map <addr_t, list <MemoryRequest *> > _missed;
+    struct entry_t {
+      addr_t blockAddr;
+      MemoryRequest *miss;
+      cycles_t issueCycle;
+      // the miss is a prefetch, and it was a prefetch when issued
+      bool prefetch;
+      bool prefetched;
+      // a demand merged into the prefetch, at lateCycle
+      bool late;
+      cycles_t lateCycle;
+      uint32 numTargets;
+      MemoryRequest *targets[MSHR_INLINE_TARGETS];
+      vector <MemoryRequest *> spilled;
+
+      entry_t() {
+        miss = NULL;
+        numTargets = 0;
+      }
+
+      MemoryRequest *&Target(uint32 i) {
+        if (i < MSHR_INLINE_TARGETS) return targets[i];
+        return spilled[i - MSHR_INLINE_TARGETS];
+      }
+
+      void AddTarget(MemoryRequest *request) {
+        if (numTargets < MSHR_INLINE_TARGETS)
+          targets[numTargets] = request;
+        else
+          spilled.push_back(request);
+        numTargets ++;
+      }
+    };
+
+    vector <entry_t> _entries;
+    vector <uint32> _free;
+    uint32 _used;
+    uint32 _prefetchUsed;
+
+    // block address -> entry index + 1 (0 is an empty slot). linear probing
+    vector <uint32> _lookup;
+    uint32 _lookupMask;
+
+    // requests waiting for a free entry (demands and prefetches), and for a
+    // target of their entry
     list <MemoryRequest *> _waitQ;
-    map <addr_t, MemoryRequest *> _outstanding;
-    map <MemoryRequest *, MemoryRequest *> _handler;
+    list <MemoryRequest *> _prefetchWaitQ;
+    list <MemoryRequest *> _targetQ;
+
+    // -------------------------------------------------------------------------
+    // Declare counters
+    // -------------------------------------------------------------------------
+
+    NEW_COUNTER(demand_misses);
+    NEW_COUNTER(prefetch_misses);
+    NEW_COUNTER(metadata_misses);
+    NEW_COUNTER(merges);
+    NEW_COUNTER(late_prefetches);
+    NEW_COUNTER(late_prefetch_saved_cycles);
+    NEW_COUNTER(late_prefetch_wait_cycles);
+    NEW_COUNTER(dropped_prefetches);
+    NEW_COUNTER(full_stalls);
+    NEW_COUNTER(target_stalls);
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the lookup slot of a block address
+    // -------------------------------------------------------------------------
+
+    uint32 Slot(addr_t blockAddr) {
+      uint64 hash = (blockAddr / _blockSize) * 0x9E3779B97F4A7C15ULL;
+      return (hash >> 32) & _lookupMask;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to find the entry of a block. Returns -1 if there is none
+    // -------------------------------------------------------------------------
+
+    int32 Find(addr_t blockAddr) {
+      for (uint32 slot = Slot(blockAddr); _lookup[slot] != 0;
+           slot = (slot + 1) & _lookupMask) {
+        if (_entries[_lookup[slot] - 1].blockAddr == blockAddr)
+          return _lookup[slot] - 1;
+      }
+      return -1;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add an entry to the lookup table
+    // -------------------------------------------------------------------------
+
+    void Insert(uint32 index) {
+      uint32 slot = Slot(_entries[index].blockAddr);
+      while (_lookup[slot] != 0)
+        slot = (slot + 1) & _lookupMask;
+      _lookup[slot] = index + 1;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to remove an entry from the lookup table. The entries after
+    // it in its probe sequence are shifted back into the hole
+    // -------------------------------------------------------------------------
+
+    void Remove(uint32 index) {
+      uint32 hole = Slot(_entries[index].blockAddr);
+      while (_lookup[hole] != index + 1)
+        hole = (hole + 1) & _lookupMask;
+      _lookup[hole] = 0;
+
+      for (uint32 slot = (hole + 1) & _lookupMask; _lookup[slot] != 0;
+           slot = (slot + 1) & _lookupMask) {
+        uint32 home = Slot(_entries[_lookup[slot] - 1].blockAddr);
+        // move the entry if the hole lies between its home and its slot
+        if (((slot - home) & _lookupMask) >= ((slot - hole) & _lookupMask)) {
+          _lookup[hole] = _lookup[slot];
+          _lookup[slot] = 0;
+          hole = slot;
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to size the entries and the lookup table. The table is kept
+    // at most half full
+    // -------------------------------------------------------------------------
+
+    void Resize(uint32 entries) {
+      uint32 first = _entries.size();
+      _entries.resize(entries);
+      for (uint32 i = entries; i > first; i --)
+        _free.push_back(i - 1);
+
+      uint32 slots = 1;
+      while (slots < 2 * entries)
+        slots <<= 1;
+      _lookup.assign(slots, 0);
+      _lookupMask = slots - 1;
+      for (uint32 i = 0; i < first; i ++)
+        if (_entries[i].miss != NULL)
+          Insert(i);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to allocate an entry for a block
+    // -------------------------------------------------------------------------
+
+    uint32 Allocate(addr_t blockAddr, MemoryRequest *miss, bool prefetch) {
+      if (_free.empty())
+        Resize(_entries.size() + MSHR_GROW_ENTRIES);
+      uint32 index = _free.back();
+      _free.pop_back();
+      entry_t &entry = _entries[index];
+      entry.blockAddr = blockAddr;
+      entry.miss = miss;
+      entry.issueCycle = miss -> currentCycle;
+      entry.prefetch = prefetch;
+      entry.prefetched = prefetch;
+      entry.late = false;
+      entry.numTargets = 0;
+      entry.spilled.clear();
+      Insert(index);
+      _used ++;
+      if (prefetch)
+        _prefetchUsed ++;
+      return index;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to free an entry
+    // -------------------------------------------------------------------------
+
+    void Free(uint32 index) {
+      if (_entries[index].prefetch)
+        _prefetchUsed --;
+      Remove(index);
+      _entries[index].miss = NULL;
+      _entries[index].numTargets = 0;
+      _free.push_back(index);
+      _used --;
+    }
 
 
   public:
@@ -57,6 +261,12 @@ class CmpMSHR : public MemoryComponent {
     CmpMSHR() {
       _count = 32;
       _blockSize = 64;
+      _targetsPerEntry = 0;
+      _prefetchEntries = 0;
+      _dropPrefetches = true;
+      _used = 0;
+      _prefetchUsed = 0;
+      _lookupMask = 0;
     }
 
 
@@ -69,6 +279,18 @@ class CmpMSHR : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void InitializeStatistics() {
+      INITIALIZE_COUNTER(demand_misses, "Demand Misses");
+      INITIALIZE_COUNTER(prefetch_misses, "Prefetch Misses");
+      INITIALIZE_COUNTER(metadata_misses, "Prefetcher Metadata Misses");
+      INITIALIZE_COUNTER(merges, "Demands Merged Into Misses");
+      INITIALIZE_COUNTER(late_prefetches, "Late Prefetches");
+      INITIALIZE_COUNTER(late_prefetch_saved_cycles,
+                         "Late Prefetch Cycles Saved");
+      INITIALIZE_COUNTER(late_prefetch_wait_cycles,
+                         "Late Prefetch Cycles Waited");
+      INITIALIZE_COUNTER(dropped_prefetches, "Prefetches Dropped When Full");
+      INITIALIZE_COUNTER(full_stalls, "Stalls For A Free Entry");
+      INITIALIZE_COUNTER(target_stalls, "Stalls For A Free Target");
     }
 
 
@@ -83,6 +305,9 @@ class CmpMSHR : public MemoryComponent {
       // Add the list of parameters to the component here
       CMP_PARAMETER_UINT("count", _count)
       CMP_PARAMETER_UINT("block-size", _blockSize)
+      CMP_PARAMETER_UINT("targets-per-entry", _targetsPerEntry)
+      CMP_PARAMETER_UINT("prefetch-entries", _prefetchEntries)
+      CMP_PARAMETER_BOOLEAN("drop-prefetches", _dropPrefetches)
 
       CMP_PARAMETER_END
     }
@@ -92,10 +317,11 @@ class CmpMSHR : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void StartSimulation() {
-      // nothing much to do
-      _missed.clear();
-      _outstanding.clear();
-      _handler.clear();
+      _entries.clear();
+      _free.clear();
+      _used = 0;
+      _prefetchUsed = 0;
+      Resize(_count != 0 ? _count : MSHR_GROW_ENTRIES);
     }
 
 
@@ -108,6 +334,17 @@ class CmpMSHR : public MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Functional path. A write miss is fetched like on the timing path
+    // -------------------------------------------------------------------------
+
+    bool WarmAccess(MemoryRequest *request) {
+      if (request -> type == MemoryRequest::WRITE)
+        request -> type = MemoryRequest::READ_FOR_WRITE;
+      return false;
+    }
+
+
   protected:
 
     // -------------------------------------------------------------------------
@@ -127,33 +364,76 @@ class CmpMSHR : public MemoryComponent {
 
       // if there is already a miss for the block, then insert it at the end of
       // that block's request list
-      if (_missed.find(blockAddr) != _missed.end()) {
+      int32 index = Find(blockAddr);
+      if (index >= 0) {
+        entry_t &entry = _entries[index];
         // write requests don't stall the processor
         if (request -> type == MemoryRequest::WRITE) {
           request -> serviced = true;
           return 0;
         }
 
+        // if the entry has no free target, stall the request until the
+        // miss returns
+        request -> stalling = true;
+        if (_targetsPerEntry != 0 && entry.numTargets >= _targetsPerEntry) {
+          INCREMENT(target_stalls);
+          _targetQ.push_back(request);
+          return 0;
+        }
+
         if (request -> type == MemoryRequest::READ)
-          _outstanding[blockAddr] -> type = MemoryRequest::READ;
+          entry.miss -> type = MemoryRequest::READ;
+
+        // a demand merging into a prefetch miss. the prefetch is late, but
+        // saves the cycles since it was issued
+        if (request -> type != MemoryRequest::PREFETCH) {
+          INCREMENT(merges);
+          if (entry.prefetch) {
+            entry.prefetch = false;
+            _prefetchUsed --;
+          }
+          if (entry.prefetched && !entry.late) {
+            entry.late = true;
+            entry.lateCycle = request -> currentCycle;
+            INCREMENT(late_prefetches);
+            if (request -> currentCycle > entry.issueCycle)
+              ADD_TO_COUNTER(late_prefetch_saved_cycles,
+                             request -> currentCycle - entry.issueCycle);
+          }
+        }
 
-        request -> stalling = true;
-        _missed[blockAddr].push_back(request);
+        entry.AddTarget(request);
         return 0;
       }
 
-      // if there are no free MSHRs, stall the request
-      if (_count != 0) {
-        if (_missed.size() == _count) {
-          request -> stalling = true;
-          _waitQ.push_back(request);
+      // if there are no free MSHRs (or the prefetches are at their quota),
+      // drop a prefetch or stall the request
+      bool prefetch = (request -> type == MemoryRequest::PREFETCH);
+      if ((_count != 0 && _used == _count) ||
+          (prefetch && _prefetchEntries != 0 &&
+           _prefetchUsed >= _prefetchEntries)) {
+        // only prefetches generated by the components can be dropped. the
+        // processor waits for its own requests
+        if (prefetch && _dropPrefetches &&
+            request -> iniType == MemoryRequest::COMPONENT) {
+          INCREMENT(dropped_prefetches);
+          PrefetchFeedback().Dropped(request -> prefetcher, blockAddr);
+          request -> destroy = true;
           return 0;
         }
+        request -> stalling = true;
+        if (prefetch) {
+          _prefetchWaitQ.push_back(request);
+        }
+        else {
+          INCREMENT(full_stalls);
+          _waitQ.push_back(request);
+        }
+        return 0;
       }
 
       // assign a new MSHR to the request      
-      _missed[blockAddr] = list <MemoryRequest *> ();
-
       MemoryRequest *miss = new MemoryRequest(MemoryRequest::COMPONENT,
           request -> cpuID, this, MemoryRequest::READ, request -> cmpID,
           request -> virtualAddress, blockAddr, _blockSize, 
@@ -162,19 +442,33 @@ class CmpMSHR : public MemoryComponent {
       miss -> type = request -> type;
       if (request -> type == MemoryRequest::WRITE)
         miss -> type = MemoryRequest::READ_FOR_WRITE;
+
+      // a prefetch miss keeps the prefetcher and the fill level
+      miss -> prefetcher = request -> prefetcher;
+      miss -> prefetcherID = request -> prefetcherID;
+      miss -> fillLevel = request -> fillLevel;
+      miss -> metadata = request -> metadata;
       
       // set icount
       miss -> icount = request -> icount;
       
-      _outstanding[blockAddr] = miss;
-
+      entry_t &entry = _entries[Allocate(blockAddr, miss, prefetch)];
+      if (prefetch) {
+        INCREMENT(prefetch_misses);
+      }
+      else if (request -> metadata) {
+        INCREMENT(metadata_misses);
+      }
+      else {
+        INCREMENT(demand_misses);
+      }
 
       if (request -> type == MemoryRequest::WRITE) {
         request -> serviced = true;
       }
       else {
         request -> stalling = true;
-        _missed[blockAddr].push_back(request);
+        entry.AddTarget(request);
       }
 
       SendToNextComponent(miss);
@@ -195,27 +489,74 @@ class CmpMSHR : public MemoryComponent {
           request -> iniPtr != this)
         return 0;
 
-      // else mark all the requests waiting for this miss as serviced
       addr_t blockAddr = request -> physicalAddress;
 
-      assert(_missed.find(blockAddr) != _missed.end());
-      list <MemoryRequest *>::iterator it;
-      for (it = _missed[blockAddr].begin(); it != _missed[blockAddr].end();
-          it ++) {
-        (*it) -> stalling = false;
-        (*it) -> serviced = true;
-        (*it) -> currentCycle = request -> currentCycle;
+      int32 index = Find(blockAddr);
+      assert(index >= 0);
+      entry_t &entry = _entries[index];
+
+      // the memory controller dropped a prefetch miss. if a demand merged
+      // into it in the meantime, reissue the miss as a demand. else the
+      // waiting prefetches are discarded without filling the block
+      if (request -> dropped) {
+        request -> dropped = false;
+        bool demand = (request -> type != MemoryRequest::PREFETCH);
+        for (uint32 i = 0; i < entry.numTargets; i ++)
+          if (entry.Target(i) -> type != MemoryRequest::PREFETCH)
+            demand = true;
+        if (demand) {
+          if (request -> type == MemoryRequest::PREFETCH)
+            request -> type = MemoryRequest::READ;
+          request -> serviced = false;
+          return 0;
+        }
+        for (uint32 i = 0; i < entry.numTargets; i ++) {
+          MemoryRequest *target = entry.Target(i);
+          PrefetchFeedback().Dropped(target -> prefetcher, blockAddr);
+          target -> stalling = false;
+          target -> destroy = true;
+          SendToNextComponent(target);
+        }
+        entry.numTargets = 0;
+      }
+
+      // else mark all the requests waiting for this miss as serviced
+      for (uint32 i = 0; i < entry.numTargets; i ++) {
+        MemoryRequest *target = entry.Target(i);
+        target -> stalling = false;
+        target -> serviced = true;
+        target -> currentCycle = request -> currentCycle;
         if (request -> dirtyReply) 
-          (*it) -> dirtyReply = true;
-        AddRequest((*it));
+          target -> dirtyReply = true;
+        AddRequest(target);
       }
 
-      // remove the entry for the miss
-      _missed.erase(blockAddr);
-      _outstanding.erase(blockAddr);
-      if (!_waitQ.empty()) {
-        MemoryRequest *front = _waitQ.front();
-        _waitQ.pop_front();
+      if (entry.late && request -> currentCycle > entry.lateCycle)
+        ADD_TO_COUNTER(late_prefetch_wait_cycles,
+                       request -> currentCycle - entry.lateCycle);
+
+      // remove the entry for the miss. the requests that found its targets
+      // full retry
+      Free(index);
+      list <MemoryRequest *>::iterator it = _targetQ.begin();
+      while (it != _targetQ.end()) {
+        if (((*it) -> physicalAddress / _blockSize) * _blockSize == blockAddr) {
+          (*it) -> stalling = false;
+          (*it) -> currentCycle = request -> currentCycle;
+          AddRequest(*it);
+          it = _targetQ.erase(it);
+        }
+        else {
+          it ++;
+        }
+      }
+      // the freed entry goes to the oldest waiting demand, else to the
+      // oldest waiting prefetch
+      list <MemoryRequest *> &waitQ =
+        (!_waitQ.empty() ? _waitQ : _prefetchWaitQ);
+      if (!waitQ.empty()) {
+        MemoryRequest *front = waitQ.front();
+        waitQ.pop_front();
         front -> stalling = false;
         AddRequest(front);
       }
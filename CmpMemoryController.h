@@ -13,6 +13,8 @@
 // -----------------------------------------------------------------------------
 
 #include "MemoryComponent.h"
+#include "Histogram.h"
+#include "GenericTable.h"
 #include "Types.h"
 
 // -----------------------------------------------------------------------------
@@ -20,11 +22,21 @@
 // -----------------------------------------------------------------------------
 
 
+// open row value of a precharged bank
+#define MC_ROW_CLOSED ((addr_t) -1)
+
 // -----------------------------------------------------------------------------
 // Class: CmpMemoryController
 // Description:
 //    Simple DRAM memory controller model. For now, single channel, single rank.
-//    Implements FCFS with drain-when-full.
+//    Implements FCFS with drain-when-full. The frfcfs-batch scheduler groups
+//    the queued writebacks by DRAM row and drains them as per-row bursts.
+//    With bank-parallel timing, banks overlap their accesses and only data
+//    bursts serialize on the bus; frfcfs-blp prefers reads to idle banks.
+//    Optionally models a memory-side buffer of recently opened row segments,
+//    demand-over-prefetch prioritization and critical-word-first returns.
+//    Refresh (all-bank or per-bank), power-down and DRAM energy are modeled
+//    per controller, i.e. per channel.
 // -----------------------------------------------------------------------------
 
 class CmpMemoryController : public MemoryComponent {
@@ -49,6 +61,41 @@ protected:
   uint32 _channelDelay;
   uint32 _busProcessorRatio;
 
+  bool _latencyHistogram;
+  bool _timeSeries;
+
+  uint32 _rowBufferEntries;
+  uint32 _rowSegmentSize;
+  uint32 _rowBufferLatency;
+  string _rowBufferPolicy;
+
+  bool _prioritizeDemands;
+  uint32 _prefetchQueueSize;
+  uint32 _prefetchDropThreshold;
+  bool _criticalWordFirst;
+  uint32 _busWidth;
+
+  bool _bankParallel;
+
+  string _refresh;
+  uint32 _refreshInterval;
+  uint32 _refreshLatency;
+  uint32 _perBankRefreshLatency;
+  uint32 _activePowerDownThreshold;
+  uint32 _prechargePowerDownThreshold;
+  uint32 _powerDownExitLatency;
+
+  // energy per operation (nJ), background power (mW) and bus clock (ns)
+  double _energyActivate;
+  double _energyRead;
+  double _energyWrite;
+  double _energyRefresh;
+  double _powerActiveStandby;
+  double _powerPrechargeStandby;
+  double _powerActivePowerDown;
+  double _powerPrechargePowerDown;
+  double _busCycleTime;
+
   uint32 _dummy;
 
   // -------------------------------------------------------------------------
@@ -73,6 +120,47 @@ protected:
   list <MemoryRequest *> _writeRowHits;
   list <MemoryRequest *> _readRowHits;
 
+  // writeback batching. queued writebacks indexed by logical row (bank and
+  // row), pointing into _writeQ so that _writeQ remains the write buffer
+  bool _writeBatching;
+  map <addr_t, list <list <MemoryRequest *>::iterator> > _writeRows;
+  addr_t _batchRow;
+  bool _inBatch;
+  // the request being issued is a write of a row batch
+  bool _batchedWrite;
+
+  // per processor read latency distribution (issue to return)
+  vector <log_histogram_t> _readLatency;
+
+  // per interval bank busy cycles and transferred bytes
+  vector <cycles_t> _bankBusy;
+  uint64 _intervalReads;
+  uint64 _intervalWrites;
+  uint64 _intervalBytes;
+
+  // memory-side buffer of row segments. a segment is read into the buffer
+  // (on the DRAM side of the channel) when its row is opened for a read
+  generic_table_t <addr_t, bool> _rowBuffer;
+
+  // prefetches wait here when demands are prioritized
+  list <MemoryRequest *> _prefetchQ;
+
+  // refresh. cycle of the next refresh command, next bank to refresh (per
+  // bank mode) and the cycle till which each bank is being refreshed
+  enum RefreshMode { REFRESH_NONE, REFRESH_ALL_BANK, REFRESH_PER_BANK };
+  RefreshMode _refreshMode;
+  cycles_t _nextRefresh;
+  uint32 _refreshBank;
+  vector <cycles_t> _refreshUntil;
+
+  // cycle till which background energy has been accounted
+  cycles_t _powerCycle;
+
+  // bank-parallel timing. cycle at which each bank can take its next
+  // command and cycle at which the data bus is free
+  vector <cycles_t> _bankReady;
+  cycles_t _busFree;
+
 
   // -------------------------------------------------------------------------
   // Declare counters
@@ -85,6 +173,25 @@ protected:
   NEW_COUNTER(rowconflicts);
   NEW_COUNTER(readtowrites);
   NEW_COUNTER(writetoreads);
+  NEW_COUNTER(write_activations);
+  NEW_COUNTER(write_batches);
+  NEW_COUNTER(batched_writes);
+  NEW_COUNTER(turnarounds_avoided);
+  NEW_COUNTER(prefetch_reads);
+  NEW_COUNTER(dropped_prefetches);
+  NEW_COUNTER(promoted_prefetches);
+  NEW_COUNTER(rowbuffer_hits);
+  NEW_COUNTER(rowbuffer_fills);
+  NEW_COUNTER(cwf_cycles_saved);
+  NEW_COUNTER(refreshes);
+  NEW_COUNTER(refresh_stalls);
+  NEW_COUNTER(refresh_stall_cycles);
+  NEW_COUNTER(active_powerdowns);
+  NEW_COUNTER(precharge_powerdowns);
+  NEW_COUNTER(active_standby_cycles);
+  NEW_COUNTER(precharge_standby_cycles);
+  NEW_COUNTER(active_powerdown_cycles);
+  NEW_COUNTER(precharge_powerdown_cycles);
 
 public:
 
@@ -103,7 +210,39 @@ public:
     _numWriteBufferEntries = 64;
     _channelDelay = 4;
     _busProcessorRatio = 8;
-    _schedAlgo = "fcfs";
+    _schedAlgo = "frfcfs";
+    _latencyHistogram = false;
+    _timeSeries = false;
+    _rowBufferEntries = 0;
+    _rowSegmentSize = 1024;
+    _rowBufferLatency = 2;
+    _rowBufferPolicy = "lru";
+    _prioritizeDemands = false;
+    _prefetchQueueSize = 32;
+    _prefetchDropThreshold = 0;
+    _criticalWordFirst = false;
+    _busWidth = 8;
+    _bankParallel = false;
+
+    // DDR3, 2Gb devices, 400 MHz bus
+    _refresh = "none";
+    _refreshInterval = 3120;
+    _refreshLatency = 64;
+    _perBankRefreshLatency = 36;
+    _activePowerDownThreshold = 0;
+    _prechargePowerDownThreshold = 0;
+    _powerDownExitLatency = 3;
+
+    // per rank of eight x8 devices
+    _energyActivate = 10.0;
+    _energyRead = 8.0;
+    _energyWrite = 8.5;
+    _energyRefresh = 120.0;
+    _powerActiveStandby = 350.0;
+    _powerPrechargeStandby = 280.0;
+    _powerActivePowerDown = 200.0;
+    _powerPrechargePowerDown = 100.0;
+    _busCycleTime = 2.5;
   }
 
 
@@ -132,6 +271,39 @@ public:
       CMP_PARAMETER_UINT("channel-delay", _channelDelay)
       CMP_PARAMETER_UINT("bus-processor-ratio", _busProcessorRatio)
 
+      CMP_PARAMETER_BOOLEAN("latency-histogram", _latencyHistogram)
+      CMP_PARAMETER_BOOLEAN("time-series", _timeSeries)
+
+      CMP_PARAMETER_UINT("row-buffer-entries", _rowBufferEntries)
+      CMP_PARAMETER_UINT("row-segment-size", _rowSegmentSize)
+      CMP_PARAMETER_UINT("row-buffer-latency", _rowBufferLatency)
+      CMP_PARAMETER_STRING("row-buffer-policy", _rowBufferPolicy)
+
+      CMP_PARAMETER_BOOLEAN("prioritize-demands", _prioritizeDemands)
+      CMP_PARAMETER_UINT("prefetch-queue-size", _prefetchQueueSize)
+      CMP_PARAMETER_UINT("prefetch-drop-threshold", _prefetchDropThreshold)
+      CMP_PARAMETER_BOOLEAN("critical-word-first", _criticalWordFirst)
+      CMP_PARAMETER_UINT("bus-width", _busWidth)
+      CMP_PARAMETER_BOOLEAN("bank-parallel", _bankParallel)
+
+      CMP_PARAMETER_STRING("refresh", _refresh)
+      CMP_PARAMETER_UINT("refresh-interval", _refreshInterval)
+      CMP_PARAMETER_UINT("refresh-latency", _refreshLatency)
+      CMP_PARAMETER_UINT("per-bank-refresh-latency", _perBankRefreshLatency)
+      CMP_PARAMETER_UINT("active-powerdown-threshold", _activePowerDownThreshold)
+      CMP_PARAMETER_UINT("precharge-powerdown-threshold", _prechargePowerDownThreshold)
+      CMP_PARAMETER_UINT("powerdown-exit-latency", _powerDownExitLatency)
+
+      CMP_PARAMETER_DOUBLE("energy-activate", _energyActivate)
+      CMP_PARAMETER_DOUBLE("energy-read", _energyRead)
+      CMP_PARAMETER_DOUBLE("energy-write", _energyWrite)
+      CMP_PARAMETER_DOUBLE("energy-refresh", _energyRefresh)
+      CMP_PARAMETER_DOUBLE("power-active-standby", _powerActiveStandby)
+      CMP_PARAMETER_DOUBLE("power-precharge-standby", _powerPrechargeStandby)
+      CMP_PARAMETER_DOUBLE("power-active-powerdown", _powerActivePowerDown)
+      CMP_PARAMETER_DOUBLE("power-precharge-powerdown", _powerPrechargePowerDown)
+      CMP_PARAMETER_DOUBLE("bus-cycle-time", _busCycleTime)
+
       CMP_PARAMETER_UINT("stall-count", _dummy)
       CMP_PARAMETER_UINT("cmp-stall-count", _dummy)
 
@@ -152,6 +324,25 @@ public:
     INITIALIZE_COUNTER(rowconflicts, "Row Buffer Conflicts");
     INITIALIZE_COUNTER(readtowrites, "Read to Write Switches");
     INITIALIZE_COUNTER(writetoreads, "Write to Read Switches");
+    INITIALIZE_COUNTER(write_activations, "Row Activations for Writes");
+    INITIALIZE_COUNTER(write_batches, "Write Row Batches Drained");
+    INITIALIZE_COUNTER(batched_writes, "Writes Issued in Row Batches");
+    INITIALIZE_COUNTER(turnarounds_avoided, "Bus Turnarounds Avoided in Write Batches");
+    INITIALIZE_COUNTER(prefetch_reads, "Prefetch Reads");
+    INITIALIZE_COUNTER(dropped_prefetches, "Prefetches Dropped Under Queue Pressure");
+    INITIALIZE_COUNTER(promoted_prefetches, "Queued Prefetches Promoted to Demands");
+    INITIALIZE_COUNTER(rowbuffer_hits, "Row Segment Buffer Hits");
+    INITIALIZE_COUNTER(rowbuffer_fills, "Row Segment Buffer Fills");
+    INITIALIZE_COUNTER(cwf_cycles_saved, "Cycles Saved by Critical Word First");
+    INITIALIZE_COUNTER(refreshes, "Refresh Commands");
+    INITIALIZE_COUNTER(refresh_stalls, "Requests Blocked by Refresh");
+    INITIALIZE_COUNTER(refresh_stall_cycles, "Cycles Requests Waited for Refresh");
+    INITIALIZE_COUNTER(active_powerdowns, "Active Power-down Entries");
+    INITIALIZE_COUNTER(precharge_powerdowns, "Precharge Power-down Entries");
+    INITIALIZE_COUNTER(active_standby_cycles, "Cycles in Active Standby");
+    INITIALIZE_COUNTER(precharge_standby_cycles, "Cycles in Precharge Standby");
+    INITIALIZE_COUNTER(active_powerdown_cycles, "Cycles in Active Power-down");
+    INITIALIZE_COUNTER(precharge_powerdown_cycles, "Cycles in Precharge Power-down");
   }
 
 
@@ -164,12 +355,60 @@ public:
     NextRequest = GetSchedulingAlgorithmFunction(_schedAlgo);
     _drain = false;
     _lastOp = MemoryRequest::READ;
+    _writeBatching = (_schedAlgo.compare("frfcfs-batch") == 0);
+    _writeRows.clear();
+    _inBatch = false;
+    _batchedWrite = false;
+
+    _readLatency.resize(_numCPUs);
+    _bankBusy.resize(_numBanks, 0);
+    _intervalReads = 0;
+    _intervalWrites = 0;
+    _intervalBytes = 0;
+
+    if (_rowBufferEntries != 0)
+      _rowBuffer.SetTableParameters(_rowBufferEntries, _rowBufferPolicy);
+    _prefetchQ.clear();
+
+    if (_refresh.compare("none") == 0) _refreshMode = REFRESH_NONE;
+    else if (_refresh.compare("all-bank") == 0) _refreshMode = REFRESH_ALL_BANK;
+    else if (_refresh.compare("per-bank") == 0) _refreshMode = REFRESH_PER_BANK;
+    else {
+      fprintf(stderr, "Error: Unknown refresh mode `%s'\n", _refresh.c_str());
+      exit(-1);
+    }
+    _refreshUntil.resize(_numBanks, 0);
+    _bankReady.resize(_numBanks, 0);
+    _busFree = 0;
+    _refreshBank = 0;
+    _powerCycle = 0;
+
+    // time series of queue occupancy, bandwidth and bank utilization
+    if (_timeSeries) {
+      NEW_LOG_FILE("timeseries", "timeseries.csv");
+      LOG("timeseries", "cycle,readq,writeq,reads,writes,bytes,bytes_per_kcycle");
+      for (uint32 i = 0; i < _numBanks; i ++)
+        LOG("timeseries", ",bank%u_util", i);
+      LOG("timeseries", "\n");
+    }
 
     _rowHitLatency *= _busProcessorRatio;
     _rowConflictLatency *= _busProcessorRatio;
     _readToWriteLatency *= _busProcessorRatio;
     _writeToReadLatency *= _busProcessorRatio;
     _channelDelay *= _busProcessorRatio;
+    _rowBufferLatency *= _busProcessorRatio;
+    _refreshInterval *= _busProcessorRatio;
+    _refreshLatency *= _busProcessorRatio;
+    _perBankRefreshLatency *= _busProcessorRatio;
+    _activePowerDownThreshold *= _busProcessorRatio;
+    _prechargePowerDownThreshold *= _busProcessorRatio;
+    _powerDownExitLatency *= _busProcessorRatio;
+
+    // per bank refresh commands are staggered over the refresh interval
+    if (_refreshMode == REFRESH_PER_BANK)
+      _refreshInterval /= _numBanks;
+    _nextRefresh = _refreshInterval;
   }
 
 
@@ -179,15 +418,108 @@ public:
   // -------------------------------------------------------------------------
     
   void HeartBeat(cycles_t hbCount) {
+
+    if (_timeSeries) {
+      LOG_W("timeseries", "%llu,%u,%u,%llu,%llu,%llu,%.2lf",
+            *_simulatorCycle, (uint32)_readQ.size(), (uint32)_writeQ.size(),
+            _intervalReads, _intervalWrites, _intervalBytes,
+            (double)_intervalBytes * 1000 / hbCount);
+      for (uint32 i = 0; i < _numBanks; i ++)
+        LOG_W("timeseries", ",%.3lf", (double)_bankBusy[i] / hbCount);
+      LOG_W("timeseries", "\n");
+    }
+
+    fill(_bankBusy.begin(), _bankBusy.end(), 0);
+    _intervalReads = 0;
+    _intervalWrites = 0;
+    _intervalBytes = 0;
+  }
+
+
+  void EndWarmUp() {
+    MemoryComponent::EndWarmUp();
+    for (uint32 i = 0; i < _numCPUs; i ++)
+      _readLatency[i].reset();
   }
 
 
   void EndSimulation() {
+
+    // account refreshes and idle time till the end of the simulation
+    Refresh(*_simulatorCycle);
+    PowerDown(*_simulatorCycle);
+
     DUMP_STATISTICS;
+
+    // energy report (nJ)
+    double cycleTime = _busCycleTime / _busProcessorRatio;
+    double refreshEnergy = _energyRefresh;
+    if (_refreshMode == REFRESH_PER_BANK)
+      refreshEnergy /= _numBanks;
+    double activate = rowconflicts * _energyActivate;
+    double read = reads * _energyRead;
+    double write = writes * _energyWrite;
+    double refresh = refreshes * refreshEnergy;
+    double background = cycleTime * 1e-3 *
+      (active_standby_cycles * _powerActiveStandby +
+       precharge_standby_cycles * _powerPrechargeStandby +
+       active_powerdown_cycles * _powerActivePowerDown +
+       precharge_powerdown_cycles * _powerPrechargePowerDown);
+    double total = activate + read + write + refresh + background;
+    CMP_LOG("energy_activate = %.1lf", activate);
+    CMP_LOG("energy_read = %.1lf", read);
+    CMP_LOG("energy_write = %.1lf", write);
+    CMP_LOG("energy_refresh = %.1lf", refresh);
+    CMP_LOG("energy_background = %.1lf", background);
+    CMP_LOG("energy_total = %.1lf", total);
+
+    if (_latencyHistogram) {
+      // tail latencies go to the simulation log, buckets to a separate file
+      NEW_LOG_FILE("latency", "latency");
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        CMP_LOG("read_latency_mean-%u = %llu", i, _readLatency[i].mean());
+        CMP_LOG("read_latency_p50-%u = %llu", i, _readLatency[i].percentile(50));
+        CMP_LOG("read_latency_p90-%u = %llu", i, _readLatency[i].percentile(90));
+        CMP_LOG("read_latency_p99-%u = %llu", i, _readLatency[i].percentile(99));
+        CMP_LOG("read_latency_p999-%u = %llu", i,
+                _readLatency[i].percentile(99.9));
+        CMP_LOG("read_latency_max-%u = %llu", i, _readLatency[i].max());
+        char prefix[16];
+        sprintf(prefix, "%u ", i);
+        _readLatency[i].dump(_logs["latency"], prefix);
+      }
+    }
     CLOSE_ALL_LOGS;
   }
 
 
+  // -------------------------------------------------------------------------
+  // Functional path. Opens the row of the request in its bank and fills the
+  // row segment buffer. DRAM is the end of the hierarchy, so the request is
+  // always serviced
+  // -------------------------------------------------------------------------
+
+  bool WarmAccess(MemoryRequest *request) {
+    addr_t logicalRow = (request -> virtualAddress) / _rowSize;
+    uint32 bankIndex = logicalRow % _numBanks;
+    uint32 rowID = logicalRow / _numBanks;
+    addr_t segment = (request -> virtualAddress) / _rowSegmentSize;
+    bool read = (request -> type != MemoryRequest::WRITEBACK);
+
+    if (_rowBufferEntries != 0 && read) {
+      if (_rowBuffer.lookup(segment)) {
+        _rowBuffer.read(segment);
+        return true;
+      }
+      _rowBuffer.insert(segment, true);
+    }
+
+    _openRow[bankIndex] = rowID;
+    _lastOp = request -> type;
+    return true;
+  }
+
+
 protected:
 
   // -------------------------------------------------------------------------
@@ -196,7 +528,17 @@ protected:
 
   MemoryRequest * (CmpMemoryController::*GetSchedulingAlgorithmFunction(
                                                                         string algo)) () {
-    if (algo.compare("fcfs")) return &CmpMemoryController::FCFS;
+    if (algo.compare("fcfs") == 0) return &CmpMemoryController::FCFS;
+    if (algo.compare("fcfs-drain") == 0)
+      return &CmpMemoryController::FCFSDrainWhenFull;
+    if (algo.compare("frfcfs") == 0)
+      return &CmpMemoryController::FRFCFSDrainWhenFull;
+    if (algo.compare("frfcfs-batch") == 0)
+      return &CmpMemoryController::FRFCFSBatchedDrain;
+    if (algo.compare("frfcfs-blp") == 0)
+      return &CmpMemoryController::FRFCFSBankAware;
+    fprintf(stderr, "Error: Unknown scheduling algorithm `%s'\n", algo.c_str());
+    exit(-1);
   }
 
 
@@ -209,14 +551,23 @@ protected:
 
     INCREMENT(accesses);
 
+    cycles_t now = request -> currentCycle;
     cycles_t latency = 0;
     cycles_t turnAround = 0;
 
+    // bring refresh and power state up to date. a request arriving at a
+    // powered down channel pays the exit latency
+    Refresh(now);
+    latency += PowerDown(now);
+
     // determine if there is a switch penalty
     switch (request -> type) {
 
     case MemoryRequest::READ: case MemoryRequest::READ_FOR_WRITE: case MemoryRequest::PREFETCH:
       INCREMENT(reads);
+      _intervalReads ++;
+      if (request -> type == MemoryRequest::PREFETCH)
+        INCREMENT(prefetch_reads);
       if (_lastOp == MemoryRequest::WRITEBACK) {
         INCREMENT(writetoreads);
         latency += _writeToReadLatency;
@@ -226,11 +577,16 @@ protected:
 
     case MemoryRequest::WRITEBACK:
       INCREMENT(writes);
+      _intervalWrites ++;
       if (_lastOp == MemoryRequest::READ) {
         INCREMENT(readtowrites);
         latency += _readToWriteLatency;
         turnAround = _readToWriteLatency;
       }
+      // a batched write following a write rides the same bus direction
+      else if (_lastOp == MemoryRequest::WRITEBACK && _batchedWrite) {
+        INCREMENT(turnarounds_avoided);
+      }
       break;
 
     case MemoryRequest::WRITE:
@@ -240,28 +596,255 @@ protected:
     }
 
     _lastOp = request -> type;
+    _batchedWrite = false;
 
       
     // Get the row address of the request
     addr_t logicalRow = (request -> virtualAddress) / _rowSize;
     uint32 bankIndex = logicalRow % _numBanks;
     uint32 rowID = logicalRow / _numBanks;
+    addr_t segment = (request -> virtualAddress) / _rowSegmentSize;
+    bool read = (request -> type != MemoryRequest::WRITEBACK);
+    bool buffered = (_rowBufferEntries != 0 && read &&
+                     _rowBuffer.lookup(segment));
+
+    // reads to a buffered row segment do not access the bank
+    cycles_t access;
+    if (buffered) {
+      _rowBuffer.read(segment);
+      INCREMENT(rowbuffer_hits);
+      access = _rowBufferLatency;
+    }
 
     // check if the access is a row hit or conflict
-    if (_openRow[bankIndex] == rowID) {
+    else if (_openRow[bankIndex] == rowID) {
       INCREMENT(rowhits);
-      latency += _rowHitLatency;
+      access = _rowHitLatency;
     }
 
     else {
       INCREMENT(rowconflicts);
-      latency += _rowConflictLatency;
+      if (request -> type == MemoryRequest::WRITEBACK)
+        INCREMENT(write_activations);
+      access = _rowConflictLatency;
       _openRow[bankIndex] = rowID;
     }
 
+    // the segment of the newly accessed row is read into the buffer
+    if (_rowBufferEntries != 0 && read && !buffered) {
+      _rowBuffer.insert(segment, true);
+      INCREMENT(rowbuffer_fills);
+    }
+
+    _intervalBytes += request -> size;
+
+    cycles_t busy;
+    cycles_t until;
+    if (_bankParallel)
+      latency = ScheduleOnBank(now, latency, turnAround, access, bankIndex,
+                               buffered, busy, until);
+    else
+      latency = ScheduleSerialized(now, latency, turnAround, access,
+                                   bankIndex, buffered, busy, until);
+
+    // the requested word comes in the first beat of the burst. the access
+    // latency above covers the whole burst, so demand reads return early
+    cycles_t burstEnd = latency;
+    if (_criticalWordFirst && read &&
+        request -> type != MemoryRequest::PREFETCH) {
+      uint32 beats = max(request -> size / _busWidth, 1U);
+      latency -= min((cycles_t)(_channelDelay - _channelDelay / beats),
+                     latency);
+    }
+
+    // a request does not return before the controller is free again. the
+    // simulator only advances to queued requests, and the returning request
+    // is what brings it back to the controller for the next one
+    if (latency < busy)
+      latency = busy;
+    if (latency < burstEnd)
+      ADD_TO_COUNTER(cwf_cycles_saved, burstEnd - latency);
+
     request -> AddLatency(latency);
     request -> serviced = true;
-    return _channelDelay + turnAround;
+
+    if (request -> type == MemoryRequest::READ ||
+        request -> type == MemoryRequest::READ_FOR_WRITE)
+      _readLatency[request -> cpuID].add(request -> currentCycle -
+                                         request -> issueCycle);
+
+    // the channel stays in active standby while busy
+    if (until > _powerCycle) {
+      ADD_TO_COUNTER(active_standby_cycles, until - _powerCycle);
+      _powerCycle = until;
+    }
+    return busy;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Serialized timing. Each request holds the controller for its data
+  // transfer and any bus turnaround, and is returned after the full access
+  // latency. Returns the latency and sets the controller busy cycles and
+  // the cycle till which the channel is active.
+  // -------------------------------------------------------------------------
+
+  cycles_t ScheduleSerialized(cycles_t now, cycles_t latency,
+                              cycles_t turnAround, cycles_t access,
+                              uint32 bankIndex, bool buffered,
+                              cycles_t &busy, cycles_t &until) {
+
+    // wait for the bank to finish refreshing. an all-bank refresh blocks
+    // the whole channel
+    cycles_t refreshWait = 0;
+    if (!buffered && _refreshUntil[bankIndex] > now + latency) {
+      refreshWait = _refreshUntil[bankIndex] - (now + latency);
+      INCREMENT(refresh_stalls);
+      ADD_TO_COUNTER(refresh_stall_cycles, refreshWait);
+      latency += refreshWait;
+      if (_refreshMode == REFRESH_PER_BANK)
+        refreshWait = 0;
+    }
+
+    if (!buffered)
+      _bankBusy[bankIndex] += latency + access - turnAround - refreshWait;
+
+    busy = _channelDelay + turnAround + refreshWait;
+    until = now + busy;
+    return latency + access;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Bank-parallel timing. The request starts at its bank once the bank is
+  // free and reserves the data bus for its burst once the data is ready.
+  // Activations to different banks overlap; only bursts serialize. The
+  // controller is held only till the command issues.
+  // -------------------------------------------------------------------------
+
+  cycles_t ScheduleOnBank(cycles_t now, cycles_t latency,
+                          cycles_t turnAround, cycles_t access,
+                          uint32 bankIndex, bool buffered,
+                          cycles_t &busy, cycles_t &until) {
+
+    // latency so far covers power-down exit and the bus turnaround. the
+    // turnaround is accounted on the bus timeline below
+    cycles_t start = now + latency - turnAround;
+
+    if (!buffered) {
+      start = max(start, _bankReady[bankIndex]);
+      if (_refreshUntil[bankIndex] > start) {
+        INCREMENT(refresh_stalls);
+        ADD_TO_COUNTER(refresh_stall_cycles, _refreshUntil[bankIndex] - start);
+        start = _refreshUntil[bankIndex];
+      }
+    }
+
+    // the access latency includes the burst
+    cycles_t dataReady = start;
+    if (access > _channelDelay)
+      dataReady += access - _channelDelay;
+    cycles_t busStart = max(dataReady, _busFree + turnAround);
+    _busFree = busStart + _channelDelay;
+
+    // the bank takes the next column command one burst after this one.
+    // any precharge and activate time is spent before that
+    if (!buffered) {
+      _bankReady[bankIndex] = start + _channelDelay;
+      if (access > _rowHitLatency)
+        _bankReady[bankIndex] += access - _rowHitLatency;
+      _bankBusy[bankIndex] += _bankReady[bankIndex] - start;
+    }
+
+    busy = start - now + _busProcessorRatio;
+    until = _busFree;
+    return _busFree - now;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Issue the refresh commands due till the given cycle. A refreshed bank is
+  // left precharged.
+  // -------------------------------------------------------------------------
+
+  void Refresh(cycles_t now) {
+    if (_refreshMode == REFRESH_NONE)
+      return;
+
+    while (_nextRefresh <= now) {
+      INCREMENT(refreshes);
+      if (_refreshMode == REFRESH_ALL_BANK) {
+        for (uint32 i = 0; i < _numBanks; i ++) {
+          _refreshUntil[i] = _nextRefresh + _refreshLatency;
+          _openRow[i] = MC_ROW_CLOSED;
+        }
+      }
+      else {
+        _refreshUntil[_refreshBank] = _nextRefresh + _perBankRefreshLatency;
+        _openRow[_refreshBank] = MC_ROW_CLOSED;
+        _refreshBank = (_refreshBank + 1) % _numBanks;
+      }
+      _nextRefresh += _refreshInterval;
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Account the background energy of the idle period till the given cycle.
+  // The channel enters active power-down after the active threshold and
+  // precharges all banks and enters precharge power-down after the
+  // precharge threshold. Returns the power-down exit latency.
+  // -------------------------------------------------------------------------
+
+  cycles_t PowerDown(cycles_t now) {
+    if (now <= _powerCycle)
+      return 0;
+
+    cycles_t idle = now - _powerCycle;
+    _powerCycle = now;
+
+    bool open = false;
+    for (uint32 i = 0; i < _numBanks; i ++)
+      if (_openRow[i] != MC_ROW_CLOSED)
+        open = true;
+
+    // time at which each power-down state is entered
+    cycles_t activeEntry = idle;
+    cycles_t prechargeEntry = idle;
+    if (_activePowerDownThreshold != 0 && _activePowerDownThreshold < idle)
+      activeEntry = _activePowerDownThreshold;
+    if (_prechargePowerDownThreshold != 0 &&
+        _prechargePowerDownThreshold < idle)
+      prechargeEntry = _prechargePowerDownThreshold;
+    if (activeEntry > prechargeEntry)
+      activeEntry = prechargeEntry;
+
+    if (open) {
+      ADD_TO_COUNTER(active_standby_cycles, activeEntry);
+      ADD_TO_COUNTER(active_powerdown_cycles, prechargeEntry - activeEntry);
+      if (activeEntry < prechargeEntry)
+        INCREMENT(active_powerdowns);
+    }
+    else {
+      // with all banks precharged, any power-down is a single precharge
+      // power-down, entered at the first threshold
+      ADD_TO_COUNTER(precharge_standby_cycles, activeEntry);
+      ADD_TO_COUNTER(precharge_powerdown_cycles, prechargeEntry - activeEntry);
+      if (activeEntry < idle)
+        INCREMENT(precharge_powerdowns);
+    }
+
+    if (prechargeEntry < idle) {
+      ADD_TO_COUNTER(precharge_powerdown_cycles, idle - prechargeEntry);
+      if (open)
+        INCREMENT(precharge_powerdowns);
+      for (uint32 i = 0; i < _numBanks; i ++)
+        _openRow[i] = MC_ROW_CLOSED;
+    }
+
+    if (activeEntry < idle)
+      return _powerDownExitLatency;
+    return 0;
   }
 
 
@@ -288,7 +871,8 @@ protected:
 
     // if the request queue is empty return
     if (_queue.empty() && _readQ.empty() && _writeQ.empty() 
-        && _readRowHits.empty() && _writeRowHits.empty()) {
+        && _readRowHits.empty() && _writeRowHits.empty()
+        && _prefetchQ.empty()) {
       _processing = false;
       return;
     }
@@ -315,12 +899,36 @@ protected:
         else {
 
           switch (request -> type) {
-          case MemoryRequest::READ: case MemoryRequest::READ_FOR_WRITE: case MemoryRequest::PREFETCH: 
+          case MemoryRequest::PREFETCH:
+            // drop prefetches when the read queues are too full or when
+            // the prefetch queue is full. the request returns without
+            // data (see CmpMSHR)
+            if ((_prefetchDropThreshold != 0 &&
+                 _readQ.size() + _prefetchQ.size() >= _prefetchDropThreshold)
+                || (_prioritizeDemands &&
+                    _prefetchQ.size() >= _prefetchQueueSize)) {
+              INCREMENT(dropped_prefetches);
+              request -> dropped = true;
+              request -> serviced = true;
+              SendToNextComponent(request);
+              break;
+            }
+            if (_prioritizeDemands) {
+              _prefetchQ.push_back(request);
+              break;
+            }
+            _readQ.push_back(request);
+            break;
+
+          case MemoryRequest::READ: case MemoryRequest::READ_FOR_WRITE:
             _readQ.push_back(request);
             break;
 
           case MemoryRequest::WRITEBACK:
             _writeQ.push_back(request);
+            if (_writeBatching)
+              _writeRows[(request -> virtualAddress) / _rowSize].push_back(
+                  -- _writeQ.end());
             break;
 
           case MemoryRequest::WRITE:
@@ -341,9 +949,13 @@ protected:
     // exceeds simulator time
     while (_currentCycle <= (*_simulatorCycle)) {
 
-      // get the next request to schedule
-      // TODO: request = (*this.*NextRequest)();
-      request = FRFCFSDrainWhenFull();
+      // get the next request to schedule. prefetches are scheduled only
+      // when there is no demand or write to schedule
+      if (!_prefetchQ.empty())
+        PromoteDemands();
+      request = (this ->* NextRequest)();
+      if (request == NULL)
+        request = NextPrefetch();
 
       if (request == NULL)
         break;
@@ -374,6 +986,155 @@ protected:
     return false;
   }
 
+
+  // -------------------------------------------------------------------------
+  // Function to check if the bank of a request can take a command now
+  // -------------------------------------------------------------------------
+
+  bool IsBankReady(MemoryRequest *request) {
+    uint32 bankIndex = ((request -> virtualAddress) / _rowSize) % _numBanks;
+    return (_bankReady[bankIndex] <= _currentCycle &&
+            _refreshUntil[bankIndex] <= _currentCycle);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // FR-FCFS over ready banks. Among reads, a row hit to a ready bank goes
+  // first, then the oldest read to a ready bank. Falls back to FR-FCFS
+  // with drain-when-full when no bank is ready or writes are draining.
+  // -------------------------------------------------------------------------
+
+  MemoryRequest * FRFCFSBankAware() {
+
+    if (_drain || _writeQ.size() >= _numWriteBufferEntries || _readQ.empty())
+      return FRFCFSDrainWhenFull();
+
+    MemoryRequest *request;
+    list <MemoryRequest *>::iterator it;
+    list <MemoryRequest *>::iterator ready = _readQ.end();
+    for (it = _readQ.begin(); it != _readQ.end(); it ++) {
+      request = *it;
+      if (!IsBankReady(request))
+        continue;
+      if (IsRowBufferHit(request)) {
+        _readQ.erase(it);
+        return request;
+      }
+      if (ready == _readQ.end())
+        ready = it;
+    }
+
+    if (ready != _readQ.end()) {
+      request = *ready;
+      _readQ.erase(ready);
+      return request;
+    }
+
+    return FRFCFSDrainWhenFull();
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Move queued prefetches that a demand has merged with (in the MSHR) to
+  // the read queue
+  // -------------------------------------------------------------------------
+
+  void PromoteDemands() {
+    list <MemoryRequest *>::iterator it = _prefetchQ.begin();
+    while (it != _prefetchQ.end()) {
+      if ((*it) -> type != MemoryRequest::PREFETCH) {
+        INCREMENT(promoted_prefetches);
+        _readQ.push_back(*it);
+        it = _prefetchQ.erase(it);
+      }
+      else
+        it ++;
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Next prefetch to schedule. Row hits first, else the oldest.
+  // -------------------------------------------------------------------------
+
+  MemoryRequest * NextPrefetch() {
+    if (_prefetchQ.empty())
+      return NULL;
+
+    MemoryRequest *request;
+    list <MemoryRequest *>::iterator it;
+    for (it = _prefetchQ.begin(); it != _prefetchQ.end(); it ++) {
+      request = *it;
+      if (IsRowBufferHit(request)) {
+        _prefetchQ.erase(it);
+        return request;
+      }
+    }
+
+    request = _prefetchQ.front();
+    _prefetchQ.pop_front();
+    return request;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // FR-FCFS with drain-when-full and row-batched writebacks. In drain mode,
+  // all queued writebacks to one row are issued back to back before moving
+  // to the next row. An open row is preferred, else the row with the most
+  // pending writebacks.
+  // -------------------------------------------------------------------------
+
+  MemoryRequest * FRFCFSBatchedDrain() {
+
+    if (_drain && _writeQ.empty()) {
+      _drain = false;
+      _inBatch = false;
+    }
+
+    if (!_drain && _writeQ.size() < _numWriteBufferEntries)
+      return FRFCFSDrainWhenFull();
+
+    _drain = true;
+
+    map <addr_t, list <list <MemoryRequest *>::iterator> >::iterator batch;
+    batch = _writeRows.end();
+    if (_inBatch)
+      batch = _writeRows.find(_batchRow);
+
+    // pick the next row to drain
+    if (batch == _writeRows.end()) {
+      map <addr_t, list <list <MemoryRequest *>::iterator> >::iterator it;
+      uint32 maxWrites = 0;
+      for (it = _writeRows.begin(); it != _writeRows.end(); it ++) {
+        if (IsRowBufferHit(*(it -> second.front()))) {
+          batch = it;
+          break;
+        }
+        if (it -> second.size() > maxWrites) {
+          maxWrites = it -> second.size();
+          batch = it;
+        }
+      }
+      assert(batch != _writeRows.end());
+      _batchRow = batch -> first;
+      _inBatch = true;
+      INCREMENT(write_batches);
+    }
+
+    list <MemoryRequest *>::iterator wit = batch -> second.front();
+    batch -> second.pop_front();
+    if (batch -> second.empty()) {
+      _writeRows.erase(batch);
+      _inBatch = false;
+    }
+
+    MemoryRequest *request = *wit;
+    _writeQ.erase(wit);
+    INCREMENT(batched_writes);
+    _batchedWrite = true;
+    return request;
+  }
+
 #include "MemorySchedulers.h"
 
 };
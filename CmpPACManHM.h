@@ -348,7 +348,8 @@ protected:
         INCREMENT(misses);
         request -> AddLatency(_tagStoreLatency);
         //_missCounter[index] ++;
-        if (!_done.test(request -> cpuID)) _procMisses[request -> cpuID] ++;
+        if (!_done[request -> cpuID] && !_functional)
+          _procMisses[request -> cpuID] ++;
       }
           
       return _tagStoreLatency;
@@ -0,0 +1,279 @@
+// -----------------------------------------------------------------------------
+// File: CmpPrefetchBuffer.h
+// Description:
+//    Defines a small fully associative buffer that holds the prefetches
+//    placed in it (fill level buffer), so that they do not pollute the
+//    caches. It sits below the caches it serves. A demand that hits in the
+//    buffer is serviced by it, and the block moves to the caches above. A
+//    write to a buffered block invalidates it.
+// -----------------------------------------------------------------------------
+
+#ifndef __CMP_PREFETCH_BUFFER_H__
+#define __CMP_PREFETCH_BUFFER_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "MemoryComponent.h"
+#include "GenericTable.h"
+#include "PrefetchMonitor.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Class: CmpPrefetchBuffer
+// Description:
+//    Defines a prefetch buffer component.
+// -----------------------------------------------------------------------------
+
+class CmpPrefetchBuffer : public MemoryComponent {
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Parameters
+  // -------------------------------------------------------------------------
+
+  uint32 _size;
+  uint32 _blockSize;
+  string _policy;
+  uint32 _latency;
+
+  uint32 _prefetchTrace;
+
+
+  // -------------------------------------------------------------------------
+  // Private members
+  // -------------------------------------------------------------------------
+
+  struct BufferEntry {
+    prefetch_line_t prefetch;
+  };
+
+  generic_table_t <addr_t, BufferEntry> _buffer;
+
+  // per prefetcher statistics
+  prefetch_monitor_t _prefetchMonitor;
+
+
+  // -------------------------------------------------------------------------
+  // Declare Counters
+  // -------------------------------------------------------------------------
+
+  NEW_COUNTER(accesses);
+  NEW_COUNTER(hits);
+  NEW_COUNTER(fills);
+  NEW_COUNTER(evictions);
+  NEW_COUNTER(invalidations);
+
+
+public:
+
+  // -------------------------------------------------------------------------
+  // Constructor. It cannot take any arguments
+  // -------------------------------------------------------------------------
+
+  CmpPrefetchBuffer() {
+    _size = 32;
+    _blockSize = 64;
+    _policy = "lru";
+    _latency = 1;
+    _prefetchTrace = 0;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Virtual functions to be implemented by the components
+  // -------------------------------------------------------------------------
+
+  // -------------------------------------------------------------------------
+  // Function to add a parameter to the component
+  // -------------------------------------------------------------------------
+
+  void AddParameter(string pname, string pvalue) {
+
+    CMP_PARAMETER_BEGIN
+
+      // Add the list of parameters to the component here
+      CMP_PARAMETER_UINT("size", _size)
+      CMP_PARAMETER_UINT("block-size", _blockSize)
+      CMP_PARAMETER_STRING("policy", _policy)
+      CMP_PARAMETER_UINT("latency", _latency)
+      CMP_PARAMETER_UINT("prefetch-trace", _prefetchTrace)
+
+    CMP_PARAMETER_END
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to initialize statistics
+  // -------------------------------------------------------------------------
+
+  void InitializeStatistics() {
+    INITIALIZE_COUNTER(accesses, "Demand Accesses")
+    INITIALIZE_COUNTER(hits, "Demand Hits")
+    INITIALIZE_COUNTER(fills, "Prefetch Fills")
+    INITIALIZE_COUNTER(evictions, "Evictions")
+    INITIALIZE_COUNTER(invalidations, "Invalidations by Writes")
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function called when simulation starts
+  // -------------------------------------------------------------------------
+
+  void StartSimulation() {
+    _buffer.SetTableParameters(_size, _policy);
+
+    // buffered prefetches do not evict demand blocks
+    _prefetchMonitor.SetVictims(0);
+    if (_prefetchTrace != 0) {
+      NEW_LOG_FILE("prefetches", "prefetches.csv");
+      LOG("prefetches", "block,prefetcher,id,issue,fill,use,evict\n");
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions called when warmup and simulation end
+  // -------------------------------------------------------------------------
+
+  void EndWarmUp() {
+    MemoryComponent::EndWarmUp();
+    _prefetchMonitor.Reset();
+    if (_prefetchTrace != 0)
+      _prefetchMonitor.SetTrace(_logs["prefetches"], _prefetchTrace);
+  }
+
+  void EndSimulation() {
+    DUMP_STATISTICS;
+    _prefetchMonitor.Dump(_simulationLog, _name);
+    for (uint32 i = 0; i < _size; i ++) {
+      table_t <addr_t, BufferEntry>::entry bufentry =
+        _buffer.entry_at_index(i);
+      if (bufentry.valid)
+        _prefetchMonitor.Resident(bufentry.value.prefetch, bufentry.key);
+    }
+    CLOSE_ALL_LOGS;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functional path. Updates the buffer without latency, statistics or
+  // prefetch monitoring
+  // -------------------------------------------------------------------------
+
+  bool WarmAccess(MemoryRequest *request) {
+
+    addr_t ctag = VADDR(request) / _blockSize;
+    if (!_buffer.lookup(ctag))
+      return false;
+
+    switch (request -> type) {
+    case MemoryRequest::READ:
+    case MemoryRequest::READ_FOR_WRITE:
+      _buffer.invalidate(ctag);
+      return true;
+    case MemoryRequest::PREFETCH:
+      return true;
+    default:
+      _buffer.invalidate(ctag);
+      return false;
+    }
+  }
+
+
+  void WarmReturn(MemoryRequest *request) {
+    addr_t ctag = VADDR(request) / _blockSize;
+    if (Fills(request) && !_buffer.lookup(ctag))
+      _buffer.insert(ctag, BufferEntry());
+  }
+
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Function to check if a returning request fills the buffer
+  // -------------------------------------------------------------------------
+
+  bool Fills(MemoryRequest *request) {
+    return (request -> type == MemoryRequest::PREFETCH &&
+            request -> fillLevel == MemoryRequest::FILL_BUFFER);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to process a request. Return value indicates number of busy
+  // cycles for the component.
+  // -------------------------------------------------------------------------
+
+  cycles_t ProcessRequest(MemoryRequest *request) {
+
+    addr_t ctag = VADDR(request) / _blockSize;
+
+    switch (request -> type) {
+
+    // a demand hit takes the block out of the buffer
+    case MemoryRequest::READ:
+    case MemoryRequest::READ_FOR_WRITE:
+      INCREMENT(accesses);
+      request -> AddLatency(_latency);
+      if (_buffer.lookup(ctag)) {
+        INCREMENT(hits);
+        _prefetchMonitor.Use(_buffer[ctag].prefetch, request -> currentCycle);
+        _buffer.invalidate(ctag);
+        request -> serviced = true;
+      }
+      return _latency;
+
+    // the block of a prefetch is already buffered. a prefetch that misses
+    // only passes through
+    case MemoryRequest::PREFETCH:
+      if (!_buffer.lookup(ctag))
+        return 0;
+      request -> AddLatency(_latency);
+      request -> serviced = true;
+      return _latency;
+
+    // writes make the buffered block stale
+    default:
+      if (_buffer.lookup(ctag)) {
+        INCREMENT(invalidations);
+        _buffer.invalidate(ctag);
+      }
+      return _latency;
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to process the return of a request. Return value indicates
+  // number of busy cycles for the component.
+  // -------------------------------------------------------------------------
+
+  cycles_t ProcessReturn(MemoryRequest *request) {
+
+    addr_t ctag = VADDR(request) / _blockSize;
+    if (!Fills(request) || _buffer.lookup(ctag))
+      return 0;
+
+    INCREMENT(fills);
+    table_t <addr_t, BufferEntry>::entry evicted;
+    evicted = _buffer.insert(ctag, BufferEntry());
+    _prefetchMonitor.Fill(_buffer[ctag].prefetch, request);
+
+    if (evicted.valid) {
+      INCREMENT(evictions);
+      _prefetchMonitor.Evict(evicted.value.prefetch, evicted.key, request);
+    }
+    return 0;
+  }
+
+};
+
+#endif // __CMP_PREFETCH_BUFFER_H__
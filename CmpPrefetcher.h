@@ -0,0 +1,462 @@
+// -----------------------------------------------------------------------------
+// File: CmpPrefetcher.h
+// Description:
+//    Defines the base of the prefetchers. It filters the requests that
+//    train the prefetcher, and issues the prefetches it generates through a
+//    common pipeline:
+//
+//    - a prefetch to another page than the request that triggers it is
+//      dropped (page-size, e.g. 4096; 0, the default, to allow), since its
+//      physical page is unknown
+//    - a prefetch to a block among the last filter-size prefetched blocks
+//      is dropped as a duplicate (0, the default, for no filter)
+//    - at most issue-rate prefetches are issued per cycle (0 for no limit).
+//      The others wait in a prefetch queue of queue-size entries, and are
+//      dropped when it is full
+//
+//    With feedback, the prefetcher subscribes to the feedback controller
+//    (see PrefetchFeedback.h), which sets its aggressiveness level at each
+//    heart beat. Train scales the degree and distance with Throttle.
+//
+//    fill-policy sets the caches the prefetches fill (see the fill level
+//    of MemoryRequest): all, llc, low, buffer, or confidence. With
+//    confidence, prefetches with a confidence of at least fill-high percent
+//    fill all the caches, those with at least fill-low fill the private
+//    caches with low priority, and the others fill fill-unconfident (llc or
+//    buffer). Each prefetcher derives the confidence from its own state,
+//    e.g. the training of a stride or a stream.
+// -----------------------------------------------------------------------------
+
+#ifndef __CMP_PREFETCHER_H__
+#define __CMP_PREFETCHER_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "MemoryComponent.h"
+#include "PrefetchFeedback.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+// -----------------------------------------------------------------------------
+// Class: CmpPrefetcher
+// Description:
+//    Base of the prefetchers. A prefetcher implements Train, and calls
+//    Prefetch for each block it wants to prefetch.
+// -----------------------------------------------------------------------------
+
+class CmpPrefetcher : public MemoryComponent {
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Parameters
+  // -------------------------------------------------------------------------
+
+  uint32 _degree;
+  uint32 _blockSize;
+  bool _prefetchOnWrite;
+
+  uint32 _pageSize;
+  uint32 _filterSize;
+  uint32 _issueRate;
+  uint32 _queueSize;
+
+  bool _feedback;
+  uint32 _feedbackMonitor;
+  uint32 _pollutionFilter;
+  prefetch_feedback_t::thresholds_t _thresholds;
+
+  string _fillPolicy;
+  uint32 _fillHigh;
+  uint32 _fillLow;
+  string _fillUnconfident;
+
+
+  // -------------------------------------------------------------------------
+  // Private members
+  // -------------------------------------------------------------------------
+
+  // recently prefetched blocks, replaced in FIFO order
+  vector <addr_t> _filter;
+  uint32 _filterNext;
+
+  // last cycle with a prefetch issued, and the prefetches issued in it
+  cycles_t _issueCycle;
+  uint32 _issued;
+
+  // id in the feedback controller, and the aggressiveness level
+  uint32 _feedbackID;
+  bool _subscribed;
+  uint32 _level;
+
+  // fill level of the prefetches, or of the unconfident ones when the
+  // fill level depends on the confidence
+  MemoryRequest::FillLevel _fillLevel;
+  MemoryRequest::FillLevel _unconfidentLevel;
+  bool _fillByConfidence;
+
+
+  // -------------------------------------------------------------------------
+  // Declare Counters
+  // -------------------------------------------------------------------------
+
+  NEW_COUNTER(num_prefetches);
+  NEW_COUNTER(page_drops);
+  NEW_COUNTER(duplicate_drops);
+  NEW_COUNTER(queue_drops);
+
+  NEW_COUNTER(useful_prefetches);
+  NEW_COUNTER(late_prefetches);
+  NEW_COUNTER(throttle_ups);
+  NEW_COUNTER(throttle_downs);
+
+
+public:
+
+  // -------------------------------------------------------------------------
+  // Constructor. It cannot take any arguments
+  // -------------------------------------------------------------------------
+
+  CmpPrefetcher() {
+    _degree = 4;
+    _blockSize = 64;
+    _prefetchOnWrite = false;
+
+    // both off by default, so that existing configurations reproduce
+    _pageSize = 0;
+    _filterSize = 0;
+    _issueRate = 0;
+    _queueSize = 32;
+
+    _feedback = false;
+    _feedbackMonitor = 512;
+    _pollutionFilter = 65536;
+    _thresholds.accuracyHigh = 0.75;
+    _thresholds.accuracyLow = 0.40;
+    _thresholds.lateness = 0.01;
+    _thresholds.pollution = 0.005;
+
+    _fillPolicy = "all";
+    _fillHigh = 75;
+    _fillLow = 40;
+    _fillUnconfident = "llc";
+
+    _subscribed = false;
+    _level = FEEDBACK_LEVELS - 1;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Virtual functions to be implemented by the components
+  // -------------------------------------------------------------------------
+
+  // -------------------------------------------------------------------------
+  // Function to add a parameter to the component
+  // -------------------------------------------------------------------------
+
+  void AddParameter(string pname, string pvalue) {
+
+    CMP_PARAMETER_BEGIN
+
+      CMP_PARAMETER_UINT("degree", _degree)
+      CMP_PARAMETER_UINT("block-size", _blockSize)
+      CMP_PARAMETER_BOOLEAN("prefetch-on-write", _prefetchOnWrite)
+
+      CMP_PARAMETER_UINT("page-size", _pageSize)
+      CMP_PARAMETER_UINT("filter-size", _filterSize)
+      CMP_PARAMETER_UINT("issue-rate", _issueRate)
+      CMP_PARAMETER_UINT("queue-size", _queueSize)
+
+      CMP_PARAMETER_BOOLEAN("feedback", _feedback)
+      CMP_PARAMETER_UINT("feedback-monitor", _feedbackMonitor)
+      CMP_PARAMETER_UINT("pollution-filter", _pollutionFilter)
+      CMP_PARAMETER_DOUBLE("accuracy-high", _thresholds.accuracyHigh)
+      CMP_PARAMETER_DOUBLE("accuracy-low", _thresholds.accuracyLow)
+      CMP_PARAMETER_DOUBLE("lateness-threshold", _thresholds.lateness)
+      CMP_PARAMETER_DOUBLE("pollution-threshold", _thresholds.pollution)
+
+      CMP_PARAMETER_STRING("fill-policy", _fillPolicy)
+      CMP_PARAMETER_UINT("fill-high", _fillHigh)
+      CMP_PARAMETER_UINT("fill-low", _fillLow)
+      CMP_PARAMETER_STRING("fill-unconfident", _fillUnconfident)
+
+    CMP_PARAMETER_END
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to initialize statistics
+  // -------------------------------------------------------------------------
+
+  void InitializeStatistics() {
+    INITIALIZE_COUNTER(num_prefetches, "Number of prefetches issued")
+    INITIALIZE_COUNTER(page_drops, "Prefetches dropped at a page boundary")
+    INITIALIZE_COUNTER(duplicate_drops, "Duplicate prefetches dropped")
+    INITIALIZE_COUNTER(queue_drops, "Prefetches dropped when queue full")
+
+    INITIALIZE_COUNTER(useful_prefetches, "Prefetches used by a demand")
+    INITIALIZE_COUNTER(late_prefetches, "Prefetches used while in flight")
+    INITIALIZE_COUNTER(throttle_ups, "Aggressiveness increases")
+    INITIALIZE_COUNTER(throttle_downs, "Aggressiveness decreases")
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function called when simulation starts
+  // -------------------------------------------------------------------------
+
+  void StartSimulation() {
+    _filter.assign(_filterSize, (addr_t)(-1));
+    _filterNext = 0;
+    _issueCycle = 0;
+    _issued = 0;
+
+    _fillByConfidence = (_fillPolicy.compare("confidence") == 0);
+    _fillLevel = (_fillByConfidence ? MemoryRequest::FILL_ALL :
+                  ParseFillLevel(_fillPolicy));
+    _unconfidentLevel = ParseFillLevel(_fillUnconfident);
+
+    if (_feedback && !_subscribed) {
+      _feedbackID = PrefetchFeedback().Subscribe(this, _feedbackMonitor,
+                                                 _pollutionFilter, _thresholds);
+      _subscribed = true;
+      _level = PrefetchFeedback().Level(_feedbackID);
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function called at a heart beat. Argument indicates cycles elapsed after
+  // previous heartbeat
+  // -------------------------------------------------------------------------
+
+  void HeartBeat(cycles_t hbCount) {
+    if (!_feedback)
+      return;
+    uint32 level = PrefetchFeedback().Interval(_feedbackID);
+    if (level > _level) INCREMENT(throttle_ups);
+    if (level < _level) INCREMENT(throttle_downs);
+    _level = level;
+  }
+
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Function to train the prefetcher with a demand request
+  // -------------------------------------------------------------------------
+
+  virtual void Train(MemoryRequest *request) = 0;
+
+
+  // -------------------------------------------------------------------------
+  // Function to scale a degree or distance to the aggressiveness level
+  // -------------------------------------------------------------------------
+
+  uint32 Throttle(uint32 value) {
+    uint32 scaled = value >> (FEEDBACK_LEVELS - 1 - _level);
+    return (scaled == 0 && value != 0 ? 1 : scaled);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to get the fill level of a fill policy
+  // -------------------------------------------------------------------------
+
+  MemoryRequest::FillLevel ParseFillLevel(string policy) {
+    if (policy.compare("all") == 0) return MemoryRequest::FILL_ALL;
+    if (policy.compare("llc") == 0) return MemoryRequest::FILL_LLC;
+    if (policy.compare("low") == 0) return MemoryRequest::FILL_LOW;
+    if (policy.compare("buffer") == 0) return MemoryRequest::FILL_BUFFER;
+    fprintf(stderr, "Error: Unknown prefetch fill policy `%s'\n",
+            policy.c_str());
+    exit(-1);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to get the fill level of a prefetch with a confidence (percent)
+  // -------------------------------------------------------------------------
+
+  MemoryRequest::FillLevel FillLevel(uint32 confidence) {
+    if (!_fillByConfidence)
+      return _fillLevel;
+    if (confidence >= _fillHigh)
+      return MemoryRequest::FILL_ALL;
+    if (confidence >= _fillLow)
+      return MemoryRequest::FILL_LOW;
+    return _unconfidentLevel;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to get the confidence (percent) of a prediction confirmed a
+  // number of times. It is 50 at threshold confirmations, and 100 at twice
+  // as many
+  // -------------------------------------------------------------------------
+
+  uint32 Confidence(uint32 confirmations, uint32 threshold) {
+    if (threshold == 0 || confirmations >= 2 * threshold)
+      return 100;
+    return (50 * confirmations) / threshold;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to create a request generated by the prefetcher
+  // -------------------------------------------------------------------------
+
+  MemoryRequest *NewRequest(MemoryRequest *trigger, MemoryRequest::Type type,
+                            addr_t vcla, addr_t pcla) {
+    MemoryRequest *request =
+      new MemoryRequest(MemoryRequest::COMPONENT, trigger -> cpuID, this,
+                        type, trigger -> cmpID, vcla, pcla, _blockSize,
+                        trigger -> currentCycle);
+    request -> icount = trigger -> icount;
+    request -> ip = trigger -> ip;
+    return request;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions to look up and add a block in the recent prefetch filter
+  // -------------------------------------------------------------------------
+
+  bool Recent(addr_t pcla) {
+    for (uint32 i = 0; i < _filter.size(); i ++)
+      if (_filter[i] == pcla)
+        return true;
+    return false;
+  }
+
+  void Remember(addr_t pcla) {
+    if (_filter.empty())
+      return;
+    _filter[_filterNext] = pcla;
+    _filterNext = (_filterNext + 1) % _filter.size();
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to prefetch a block for a request, with the confidence of the
+  // prefetcher in the prefetch (percent). Returns false if the prefetch is
+  // dropped
+  // -------------------------------------------------------------------------
+
+  bool Prefetch(MemoryRequest *trigger, addr_t vcla, addr_t pcla,
+                uint32 prefetcherID = 0, uint32 confidence = 100) {
+
+    if (_pageSize != 0 &&
+        vcla / _pageSize != (trigger -> virtualAddress) / _pageSize) {
+      INCREMENT(page_drops);
+      return false;
+    }
+
+    if (Recent(pcla)) {
+      INCREMENT(duplicate_drops);
+      return false;
+    }
+
+    // take the next issue slot. the prefetches in the slots after the
+    // current cycle are in the queue
+    cycles_t cycle = trigger -> currentCycle;
+    if (_issueRate != 0 && !_functional) {
+      if (_issueCycle < cycle) {
+        _issueCycle = cycle;
+        _issued = 0;
+      }
+      if (_issued == _issueRate) {
+        uint64 queued = (_issueCycle - cycle) * _issueRate;
+        if (_queueSize != 0 && queued >= _queueSize) {
+          INCREMENT(queue_drops);
+          return false;
+        }
+        _issueCycle ++;
+        _issued = 0;
+      }
+      _issued ++;
+      cycle = _issueCycle;
+    }
+    Remember(pcla);
+
+    MemoryRequest *prefetch =
+      NewRequest(trigger, MemoryRequest::PREFETCH, vcla, pcla);
+    prefetch -> currentCycle = cycle;
+    prefetch -> prefetcher = this;
+    prefetch -> prefetcherID = prefetcherID;
+    prefetch -> fillLevel = FillLevel(confidence);
+    if (_feedback && !_functional)
+      PrefetchFeedback().Issued(_feedbackID, pcla);
+    SendToNextComponent(prefetch);
+    INCREMENT(num_prefetches);
+    return true;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to process a request. Return value indicates number of busy
+  // cycles for the component.
+  // -------------------------------------------------------------------------
+
+  cycles_t ProcessRequest(MemoryRequest *request) {
+
+    if (request -> type == MemoryRequest::WRITE ||
+        request -> type == MemoryRequest::WRITEBACK ||
+        request -> type == MemoryRequest::PREFETCH ||
+        request -> metadata) {
+      // do nothing
+      return 0;
+    }
+
+    if (_feedback && !_functional) {
+      uint32 outcome = PrefetchFeedback().Demand(
+        _feedbackID, PBLOCK_ADDRESS(request, _blockSize),
+        request -> currentCycle);
+      if (outcome != FEEDBACK_NONE) INCREMENT(useful_prefetches);
+      if (outcome == FEEDBACK_LATE) INCREMENT(late_prefetches);
+    }
+
+    if (!_prefetchOnWrite &&
+        (request -> type == MemoryRequest::READ_FOR_WRITE)) {
+      // do nothing
+      return 0;
+    }
+
+    Train(request);
+    return 0;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to process the return of a request. Return value indicates
+  // number of busy cycles for the component.
+  // -------------------------------------------------------------------------
+
+  cycles_t ProcessReturn(MemoryRequest *request) {
+
+    // if its a prefetch from this component, delete it
+    if (request -> iniType == MemoryRequest::COMPONENT &&
+        request -> iniPtr == this) {
+      request -> destroy = true;
+      if (_feedback && !_functional)
+        PrefetchFeedback().Filled(_feedbackID,
+                                  PBLOCK_ADDRESS(request, _blockSize),
+                                  request -> currentCycle);
+    }
+
+    return 0;
+  }
+
+};
+
+#endif // __CMP_PREFETCHER_H__
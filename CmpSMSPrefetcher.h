@@ -0,0 +1,253 @@
+// -----------------------------------------------------------------------------
+// File: CmpSMSPrefetcher.h
+// Description:
+//    Defines a spatial region prefetcher, similar to spatial memory
+//    streaming (SMS). Memory is divided into regions of region-size bytes.
+//    The first access to a region (the trigger) starts a generation, and the
+//    blocks accessed in the region during the generation are recorded in a
+//    footprint. A generation ends when its region leaves the accumulation
+//    table, and its footprint is stored in the pattern history table, keyed
+//    by the ip and the region offset of the trigger. On a trigger, the
+//    footprint stored for its key is prefetched, nearest blocks after the
+//    trigger first.
+// -----------------------------------------------------------------------------
+
+#ifndef __CMP_SMS_PREFETCHER_H__
+#define __CMP_SMS_PREFETCHER_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "CmpPrefetcher.h"
+#include "GenericTable.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+
+// footprints are 64-bit masks
+#define SMS_MAX_REGION_BLOCKS 64
+
+
+// -----------------------------------------------------------------------------
+// Class: CmpSMSPrefetcher
+// Description:
+// This class implements a spatial region prefetcher that replays the
+// footprints of previous generations with the same trigger. Blocks in
+// the last two footprints of the trigger are prefetched with full
+// confidence, blocks only in the last one with half.
+// -----------------------------------------------------------------------------
+
+class CmpSMSPrefetcher : public CmpPrefetcher {
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Parameters
+  // -------------------------------------------------------------------------
+
+  uint32 _regionSize;
+  uint32 _accumulationSize;
+  uint32 _patternSize;
+  string _patternPolicy;
+
+
+  // -------------------------------------------------------------------------
+  // Private members
+  // -------------------------------------------------------------------------
+
+  // a generation of a region: the key of its trigger and the blocks
+  // accessed so far
+  struct RegionEntry {
+    uint64 trigger;
+    uint64 footprint;
+  };
+
+  // the footprint of the last generation of a trigger, and the blocks
+  // also in the one before
+  struct PatternEntry {
+    uint64 footprint;
+    uint64 repeated;
+  };
+
+  generic_table_t <addr_t, RegionEntry> _accumulation;
+  generic_table_t <uint64, PatternEntry> _patterns;
+
+  uint32 _regionBlocks;
+
+
+  // -------------------------------------------------------------------------
+  // Declare Counters
+  // -------------------------------------------------------------------------
+
+  NEW_COUNTER(generations);
+  NEW_COUNTER(pattern_hits);
+  NEW_COUNTER(pattern_misses);
+
+
+public:
+
+  // -------------------------------------------------------------------------
+  // Constructor. It cannot take any arguments
+  // -------------------------------------------------------------------------
+
+  CmpSMSPrefetcher() {
+    _regionSize = 2048;
+    _accumulationSize = 64;
+    _patternSize = 2048;
+    _patternPolicy = "lru";
+
+    // a trigger replays its whole footprint
+    _degree = SMS_MAX_REGION_BLOCKS;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Virtual functions to be implemented by the components
+  // -------------------------------------------------------------------------
+
+  // -------------------------------------------------------------------------
+  // Function to add a parameter to the component
+  // -------------------------------------------------------------------------
+
+  void AddParameter(string pname, string pvalue) {
+
+    CMP_PARAMETER_BEGIN
+
+      // Add the list of parameters to the component here
+      CMP_PARAMETER_UINT("region-size", _regionSize)
+      CMP_PARAMETER_UINT("accumulation-size", _accumulationSize)
+      CMP_PARAMETER_UINT("pattern-size", _patternSize)
+      CMP_PARAMETER_STRING("pattern-policy", _patternPolicy)
+
+    CMP_PARAMETER_PARENT(CmpPrefetcher)
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to initialize statistics
+  // -------------------------------------------------------------------------
+
+  void InitializeStatistics() {
+    CmpPrefetcher::InitializeStatistics();
+    INITIALIZE_COUNTER(generations, "Region generations recorded")
+    INITIALIZE_COUNTER(pattern_hits, "Triggers with a footprint")
+    INITIALIZE_COUNTER(pattern_misses, "Triggers without a footprint")
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function called when simulation starts
+  // -------------------------------------------------------------------------
+
+  void StartSimulation() {
+    CmpPrefetcher::StartSimulation();
+
+    _regionBlocks = _regionSize / _blockSize;
+    if (_regionBlocks == 0 || _regionBlocks > SMS_MAX_REGION_BLOCKS) {
+      fprintf(stderr, "SMS region must have 1 to %u blocks\n",
+              SMS_MAX_REGION_BLOCKS);
+      exit(0);
+    }
+
+    _accumulation.SetTableParameters(_accumulationSize, "lru");
+    _patterns.SetTableParameters(_patternSize, _patternPolicy);
+  }
+
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Function to get the pattern key of a trigger
+  // -------------------------------------------------------------------------
+
+  uint64 TriggerKey(addr_t ip, uint32 offset) {
+    return ((uint64)ip * SMS_MAX_REGION_BLOCKS) + offset;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to store the footprint of a generation that ends. Footprints of
+  // the trigger block alone are not worth storing
+  // -------------------------------------------------------------------------
+
+  void Record(RegionEntry &generation) {
+    uint64 others = generation.footprint & (generation.footprint - 1);
+    if (others == 0)
+      return;
+
+    INCREMENT(generations);
+    PatternEntry pattern;
+    pattern.footprint = generation.footprint;
+    pattern.repeated = 0;
+    if (_patterns.lookup(generation.trigger)) {
+      pattern.repeated = generation.footprint &
+        _patterns[generation.trigger].footprint;
+      _patterns.update(generation.trigger, pattern);
+    }
+    else
+      _patterns.insert(generation.trigger, pattern);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to train the prefetcher with a demand request
+  // -------------------------------------------------------------------------
+
+  void Train(MemoryRequest *request) {
+
+    addr_t vcla = VBLOCK_ADDRESS(request, _blockSize);
+    addr_t pcla = PBLOCK_ADDRESS(request, _blockSize);
+
+    addr_t region = vcla / _regionSize;
+    uint32 offset = (vcla % _regionSize) / _blockSize;
+
+    // access in an active generation
+    if (_accumulation.lookup(region)) {
+      _accumulation.read(region);
+      _accumulation[region].footprint |= (1ULL << offset);
+      return;
+    }
+
+    // trigger access. start a generation, and end the one it replaces
+    RegionEntry generation;
+    generation.trigger = TriggerKey(request -> ip, offset);
+    generation.footprint = (1ULL << offset);
+
+    table_t <addr_t, RegionEntry>::entry evicted;
+    evicted = _accumulation.insert(region, generation);
+    if (evicted.valid)
+      Record(evicted.value);
+
+    if (!_patterns.lookup(generation.trigger)) {
+      INCREMENT(pattern_misses);
+      return;
+    }
+    INCREMENT(pattern_hits);
+
+    // replay the footprint
+    PatternEntry pattern = _patterns.read(generation.trigger).value;
+    addr_t vbase = vcla - offset * _blockSize;
+    addr_t pbase = pcla - offset * _blockSize;
+    uint32 degree = Throttle(_degree);
+    uint32 numPrefetches = 0;
+
+    for (uint32 i = 1; i < _regionBlocks && numPrefetches < degree; i ++) {
+      uint32 block = (offset + i) % _regionBlocks;
+      if (!(pattern.footprint & (1ULL << block)))
+        continue;
+      uint32 confidence = (pattern.repeated & (1ULL << block)) ? 100 : 50;
+      Prefetch(request, vbase + block * _blockSize, pbase + block * _blockSize,
+               0, confidence);
+      numPrefetches ++;
+    }
+  }
+
+};
+
+#endif // __CMP_SMS_PREFETCHER_H__
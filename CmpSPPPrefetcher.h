@@ -0,0 +1,307 @@
+// -----------------------------------------------------------------------------
+// File: CmpSPPPrefetcher.h
+// Description:
+//    Defines a signature path prefetcher (SPP). The signature table keeps,
+//    for each page, the offset of the last block accessed and a signature
+//    compressing the history of the deltas between the accesses. The pattern
+//    table, indexed by signature, counts the deltas that followed the
+//    signature. On an access, the prefetcher walks the signature path: it
+//    prefetches the deltas of the signature whose confidence reaches the
+//    threshold, then follows the most confident delta to the next signature,
+//    multiplying the confidences along the path. The walk stops when the
+//    path confidence falls below the threshold, when it leaves the page, or
+//    after degree prefetches. The path confidence of a prefetch is its
+//    confidence for the fill policy (see CmpPrefetcher.h).
+// -----------------------------------------------------------------------------
+
+#ifndef __CMP_SPP_PREFETCHER_H__
+#define __CMP_SPP_PREFETCHER_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "CmpPrefetcher.h"
+#include "GenericTable.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+
+// deltas are folded into the signature as 7-bit sign-magnitude values
+#define SPP_DELTA_BITS 7
+#define SPP_SIGNATURE_SHIFT 3
+
+
+// -----------------------------------------------------------------------------
+// Class: CmpSPPPrefetcher
+// Description:
+// This class implements a signature path prefetcher with lookahead.
+// -----------------------------------------------------------------------------
+
+class CmpSPPPrefetcher : public CmpPrefetcher {
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Parameters
+  // -------------------------------------------------------------------------
+
+  uint32 _signatureSize;
+  uint32 _patternSize;
+  uint32 _signatureBits;
+  uint32 _deltasPerEntry;
+  uint32 _counterMax;
+  uint32 _threshold;
+
+
+  // -------------------------------------------------------------------------
+  // Private members
+  // -------------------------------------------------------------------------
+
+  struct SignatureEntry {
+    uint32 lastOffset;
+    uint32 signature;
+  };
+
+  struct DeltaEntry {
+    int32 delta;
+    uint32 count;
+  };
+
+  struct PatternEntry {
+    uint32 count;
+    vector <DeltaEntry> deltas;
+  };
+
+  generic_table_t <addr_t, SignatureEntry> _signatures;
+  vector <PatternEntry> _patterns;
+
+  uint32 _pageBlocks;
+  uint32 _signatureMask;
+
+
+  // -------------------------------------------------------------------------
+  // Declare Counters
+  // -------------------------------------------------------------------------
+
+  NEW_COUNTER(pattern_updates);
+  NEW_COUNTER(lookahead_steps);
+
+
+public:
+
+  // -------------------------------------------------------------------------
+  // Constructor. It cannot take any arguments
+  // -------------------------------------------------------------------------
+
+  CmpSPPPrefetcher() {
+    _signatureSize = 256;
+    _patternSize = 512;
+    _signatureBits = 12;
+    _deltasPerEntry = 4;
+    _counterMax = 15;
+    _threshold = 25;
+
+    _degree = 16;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Virtual functions to be implemented by the components
+  // -------------------------------------------------------------------------
+
+  // -------------------------------------------------------------------------
+  // Function to add a parameter to the component
+  // -------------------------------------------------------------------------
+
+  void AddParameter(string pname, string pvalue) {
+
+    CMP_PARAMETER_BEGIN
+
+      // Add the list of parameters to the component here
+      CMP_PARAMETER_UINT("signature-size", _signatureSize)
+      CMP_PARAMETER_UINT("pattern-size", _patternSize)
+      CMP_PARAMETER_UINT("signature-bits", _signatureBits)
+      CMP_PARAMETER_UINT("deltas-per-entry", _deltasPerEntry)
+      CMP_PARAMETER_UINT("counter-max", _counterMax)
+      CMP_PARAMETER_UINT("threshold", _threshold)
+
+    CMP_PARAMETER_PARENT(CmpPrefetcher)
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to initialize statistics
+  // -------------------------------------------------------------------------
+
+  void InitializeStatistics() {
+    CmpPrefetcher::InitializeStatistics();
+    INITIALIZE_COUNTER(pattern_updates, "Pattern table updates")
+    INITIALIZE_COUNTER(lookahead_steps, "Lookahead steps along a path")
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function called when simulation starts
+  // -------------------------------------------------------------------------
+
+  void StartSimulation() {
+    CmpPrefetcher::StartSimulation();
+
+    // without a page size, pages are 4KB for the signatures
+    _pageBlocks = (_pageSize != 0 ? _pageSize : 4096) / _blockSize;
+    _signatureMask = (1U << _signatureBits) - 1;
+
+    _signatures.SetTableParameters(_signatureSize, "lru");
+
+    PatternEntry empty;
+    empty.count = 0;
+    DeltaEntry none = {0, 0};
+    empty.deltas.assign(_deltasPerEntry, none);
+    _patterns.assign(_patternSize, empty);
+  }
+
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Function to fold a delta into a signature
+  // -------------------------------------------------------------------------
+
+  uint32 NextSignature(uint32 signature, int32 delta) {
+    uint32 magnitude = (delta < 0 ? -delta : delta) &
+      ((1U << (SPP_DELTA_BITS - 1)) - 1);
+    uint32 folded = (delta < 0 ? (1U << (SPP_DELTA_BITS - 1)) | magnitude :
+                     magnitude);
+    return ((signature << SPP_SIGNATURE_SHIFT) ^ folded) & _signatureMask;
+  }
+
+  PatternEntry &Pattern(uint32 signature) {
+    return _patterns[signature % _patternSize];
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to count a delta that followed a signature. The counters of the
+  // entry are halved when one saturates
+  // -------------------------------------------------------------------------
+
+  void UpdatePattern(uint32 signature, int32 delta) {
+
+    INCREMENT(pattern_updates);
+    PatternEntry &pattern = Pattern(signature);
+
+    uint32 slot = 0;
+    for (uint32 i = 0; i < pattern.deltas.size(); i ++) {
+      if (pattern.deltas[i].count != 0 && pattern.deltas[i].delta == delta) {
+        slot = i;
+        break;
+      }
+      if (pattern.deltas[i].count < pattern.deltas[slot].count)
+        slot = i;
+    }
+    if (pattern.deltas[slot].delta != delta || pattern.deltas[slot].count == 0) {
+      pattern.deltas[slot].delta = delta;
+      pattern.deltas[slot].count = 0;
+    }
+
+    pattern.deltas[slot].count ++;
+    pattern.count ++;
+
+    if (pattern.count > _counterMax || pattern.deltas[slot].count > _counterMax) {
+      pattern.count /= 2;
+      for (uint32 i = 0; i < pattern.deltas.size(); i ++)
+        pattern.deltas[i].count /= 2;
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to train the prefetcher with a demand request
+  // -------------------------------------------------------------------------
+
+  void Train(MemoryRequest *request) {
+
+    addr_t vcla = VBLOCK_ADDRESS(request, _blockSize);
+    addr_t pcla = PBLOCK_ADDRESS(request, _blockSize);
+
+    addr_t page = vcla / (_pageBlocks * _blockSize);
+    int32 offset = (vcla / _blockSize) % _pageBlocks;
+
+    // first access to the page. nothing to learn from yet
+    if (!_signatures.lookup(page)) {
+      SignatureEntry entry;
+      entry.lastOffset = offset;
+      entry.signature = 0;
+      _signatures.insert(page, entry);
+      return;
+    }
+
+    _signatures.read(page);
+    SignatureEntry &entry = _signatures[page];
+    int32 delta = offset - (int32)entry.lastOffset;
+    if (delta == 0)
+      return;
+
+    UpdatePattern(entry.signature, delta);
+    entry.signature = NextSignature(entry.signature, delta);
+    entry.lastOffset = offset;
+
+    // walk the signature path
+    addr_t vpage = vcla - offset * _blockSize;
+    addr_t ppage = pcla - offset * _blockSize;
+    uint32 signature = entry.signature;
+    uint32 confidence = 100;
+    uint32 degree = Throttle(_degree);
+    uint32 numPrefetches = 0;
+
+    while (numPrefetches < degree) {
+
+      PatternEntry &pattern = Pattern(signature);
+      if (pattern.count == 0)
+        break;
+
+      int32 bestDelta = 0;
+      uint32 bestConfidence = 0;
+
+      for (uint32 i = 0; i < pattern.deltas.size() &&
+             numPrefetches < degree; i ++) {
+        DeltaEntry &candidate = pattern.deltas[i];
+        if (candidate.count == 0)
+          continue;
+
+        uint32 pathConfidence = confidence * candidate.count / pattern.count;
+        if (pathConfidence < _threshold)
+          continue;
+        if (pathConfidence > bestConfidence) {
+          bestConfidence = pathConfidence;
+          bestDelta = candidate.delta;
+        }
+
+        int32 target = offset + candidate.delta;
+        if (target < 0 || target >= (int32)_pageBlocks)
+          continue;
+        Prefetch(request, vpage + target * _blockSize,
+                 ppage + target * _blockSize, 0, pathConfidence);
+        numPrefetches ++;
+      }
+
+      // follow the most confident delta
+      if (bestConfidence == 0)
+        break;
+      offset += bestDelta;
+      if (offset < 0 || offset >= (int32)_pageBlocks)
+        break;
+      signature = NextSignature(signature, bestDelta);
+      confidence = bestConfidence;
+      INCREMENT(lookahead_steps);
+    }
+  }
+
+};
+
+#endif // __CMP_SPP_PREFETCHER_H__
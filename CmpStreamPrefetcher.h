@@ -11,7 +11,7 @@
 // Module includes
 // -----------------------------------------------------------------------------
 
-#include "MemoryComponent.h"
+#include "CmpPrefetcher.h"
 #include "GenericTable.h"
 #include "Types.h"
 
@@ -20,16 +20,21 @@
 // -----------------------------------------------------------------------------
 
 #include <cstdlib>
+#include <vector>
+
+// entries checked together by a stream lookup
+#define STREAM_LOOKUP_WIDTH 8
 
 // -----------------------------------------------------------------------------
 // Class: CmpStreamPrefetcher
 // Description:
 // This class implements a stream prefetcher. Similar to the IBM
 // Power prefetchers. Imported primarily from the stream
-// prefetcher in scarab/ringo
+// prefetcher in scarab/ringo. The confidence of the prefetches grows
+// with the demands that trained the stream and followed it
 // -----------------------------------------------------------------------------
 
-class CmpStreamPrefetcher : public MemoryComponent {
+class CmpStreamPrefetcher : public CmpPrefetcher {
 
 protected:
 
@@ -37,15 +42,11 @@ protected:
   // Parameters
   // -------------------------------------------------------------------------
 
-  uint32 _blockSize;
-  bool _prefetchOnWrite;
-  
   uint32 _tableSize;
   string _tablePolicy;
   uint32 _numTrains;
   uint32 _trainDistance;
   uint32 _distance;
-  uint32 _degree;
   uint32 _maxFakeCounter;
   bool _fake;
 
@@ -85,7 +86,8 @@ protected:
     addr_t fake_vp;
     addr_t fake_pp;
 
-    // is the prefetcher trained
+    // is the prefetcher trained. trainHits keeps counting the demands in
+    // a trained stream, up to twice the number of trains
     int trainHits;
     bool trained;
     StreamDirection direction;
@@ -100,16 +102,23 @@ protected:
   // implementation
   uint32 _runningIndex;
 
+  // Copy of the stream table fields that the address lookups check, one
+  // array per field, indexed by the table index and padded to a multiple
+  // of STREAM_LOOKUP_WIDTH entries. An address matches an entry when it
+  // is between its low and high addresses: within training distance of
+  // the miss address for a training entry, between the start and end
+  // pointers for a trained entry. Invalid entries have an empty range.
+  // Updated with Mirror whenever an entry changes
+  vector <addr_t> _lowAddress;
+  vector <addr_t> _highAddress;
+  vector <addr_t> _startAddress;
+  vector <addr_t> _endAddress;
+  vector <uint32> _keys;
+  vector <bool> _valid;
+
   // Frequently used values
   addr_t _trainAddrDistance;
   addr_t _prefetchAddrDistance;
-
-  
-  // -------------------------------------------------------------------------
-  // Declare Counters
-  // -------------------------------------------------------------------------
-
-  NEW_COUNTER(num_prefetches);
   
 public:
 
@@ -118,15 +127,11 @@ public:
   // -------------------------------------------------------------------------
 
   CmpStreamPrefetcher() {
-    _blockSize = 64;
-    _prefetchOnWrite = false;
-
     _tableSize = 16;
     _tablePolicy = "lru";
     _trainDistance = 16;
     _numTrains = 2;
     _distance = 24;
-    _degree = 4;
     _maxFakeCounter = 16;
     _fake = false;
   }
@@ -145,8 +150,6 @@ public:
     CMP_PARAMETER_BEGIN
 
       // Add the list of parameters to the component here
-      CMP_PARAMETER_UINT("block-size", _blockSize)
-      CMP_PARAMETER_BOOLEAN("prefetch-on-write", _prefetchOnWrite)
       CMP_PARAMETER_BOOLEAN("fake", _fake)
 
       CMP_PARAMETER_UINT("table-size", _tableSize)
@@ -154,10 +157,9 @@ public:
       CMP_PARAMETER_UINT("train-distance", _trainDistance)
       CMP_PARAMETER_UINT("num-trains", _numTrains)
       CMP_PARAMETER_UINT("distance", _distance)
-      CMP_PARAMETER_UINT("degree", _degree)
       CMP_PARAMETER_UINT("max-fake-counter", _maxFakeCounter)
 
-    CMP_PARAMETER_END
+    CMP_PARAMETER_PARENT(CmpPrefetcher)
  }
 
 
@@ -166,7 +168,7 @@ public:
   // -------------------------------------------------------------------------
 
   void InitializeStatistics() {
-    INITIALIZE_COUNTER(num_prefetches, "Number of prefetches issued")
+    CmpPrefetcher::InitializeStatistics();
   }
 
 
@@ -175,9 +177,19 @@ public:
   // -------------------------------------------------------------------------
 
   void StartSimulation() {
+    CmpPrefetcher::StartSimulation();
     _streamTable.SetTableParameters(_tableSize, _tablePolicy);
     _runningIndex = 0;
 
+    uint32 lookupSize = (_tableSize + STREAM_LOOKUP_WIDTH - 1) /
+      STREAM_LOOKUP_WIDTH * STREAM_LOOKUP_WIDTH;
+    _lowAddress.assign(lookupSize, 1);
+    _highAddress.assign(lookupSize, 0);
+    _startAddress.assign(_tableSize, 0);
+    _endAddress.assign(_tableSize, 0);
+    _keys.assign(_tableSize, 0);
+    _valid.assign(_tableSize, false);
+
     _appCounter.resize(_numCPUs, 0);
 
     _trainAddrDistance = _trainDistance * _blockSize;
@@ -185,84 +197,102 @@ public:
   }
 
 
+protected:
+
   // -------------------------------------------------------------------------
-  // Function called at a heart beat. Argument indicates cycles elapsed after
-  // previous heartbeat
+  // Function to copy the state of an entry of the stream table to the
+  // lookup arrays
   // -------------------------------------------------------------------------
 
-  void HeartBeat(cycles_t hbCount) {
+  void Mirror(uint32 index, uint32 key, StreamEntry &entry) {
+    addr_t alloc = entry.allocMissAddress;
+    if (entry.trained) {
+      _lowAddress[index] = entry.sp;
+      _highAddress[index] = entry.ep;
+    }
+    else if (_trainAddrDistance == 0) {
+      _lowAddress[index] = 1;
+      _highAddress[index] = 0;
+    }
+    else {
+      _lowAddress[index] = (alloc >= _trainAddrDistance ?
+                            alloc - _trainAddrDistance + 1 : 0);
+      _highAddress[index] = alloc + _trainAddrDistance - 1;
+    }
+    _startAddress[index] = entry.sp;
+    _endAddress[index] = entry.ep;
+    _keys[index] = key;
+    _valid[index] = true;
   }
 
+  void Unmirror(uint32 index) {
+    _lowAddress[index] = 1;
+    _highAddress[index] = 0;
+    _valid[index] = false;
+  }
 
-protected:
 
   // -------------------------------------------------------------------------
-  // Function to process a request. Return value indicates number of busy
-  // cycles for the component.
+  // Function to find the stream that covers an address. Returns the index
+  // of the first matching entry, or the table size if there is none. The
+  // entries are range checked STREAM_LOOKUP_WIDTH at a time, without
+  // branches, so that the compiler vectorizes the check
   // -------------------------------------------------------------------------
 
-  cycles_t ProcessRequest(MemoryRequest *request) {
-
-    if (request -> type == MemoryRequest::WRITE ||
-        request -> type == MemoryRequest::WRITEBACK ||
-        request -> type == MemoryRequest::PREFETCH) {
-      // do nothing
-      return 0;
-    }
-
-    if (!_prefetchOnWrite &&
-        (request -> type == MemoryRequest::READ_FOR_WRITE)) {
-      // do nothing
-      return 0;
+  uint32 FindStream(addr_t vcla) {
+    const addr_t *low = &_lowAddress[0];
+    const addr_t *high = &_highAddress[0];
+    for (uint32 base = 0; base < _tableSize; base += STREAM_LOOKUP_WIDTH) {
+      uint32 mask = 0;
+      for (uint32 i = 0; i < STREAM_LOOKUP_WIDTH; i ++)
+        mask |= (uint32)((low[base + i] <= vcla) &
+                         (vcla <= high[base + i])) << i;
+      if (mask != 0)
+        return base + __builtin_ctz(mask);
     }
+    return _tableSize;
+  }
 
-    _appCounter[request -> cpuID] ++;
 
-    addr_t vcla = VBLOCK_ADDRESS(request, _blockSize);
-    addr_t pcla = PBLOCK_ADDRESS(request, _blockSize);
-    
-    table_t <uint32, StreamEntry>::entry row;
+  // -------------------------------------------------------------------------
+  // Function to invalidate the streams, other than the one at index, that
+  // start or end between low and high
+  // -------------------------------------------------------------------------
 
-    bool hit = false;
-    uint32 key;
-    
-    // Check if there is a stream entry matching the address
+  void RemoveOverlapping(uint32 index, addr_t low, addr_t high) {
     for (uint32 i = 0; i < _tableSize; i ++) {
+      if (i == index || !_valid[i]) continue;
+      if ((_startAddress[i] <= high && _startAddress[i] >= low) ||
+          (_endAddress[i] <= high && _endAddress[i] >= low)) {
+        _streamTable.invalidate(_keys[i]);
+        Unmirror(i);
+      }
+    }
+  }
 
-      // get row i from the stream table
-      row = _streamTable.entry_at_index(i);
-
-      // if row is invalid, continue
-      if (!row.valid) continue;
 
-      // get the stream entry information
-      StreamEntry entry = row.value;
+  // -------------------------------------------------------------------------
+  // Function to train the prefetcher with a demand request
+  // -------------------------------------------------------------------------
 
-      // if entry is in the training phase
-      if (!row.value.trained) {
-        if (llabs(entry.allocMissAddress - vcla) < _trainAddrDistance) {
-          // HIT! entry within training scope
-          hit = true;
-          key = row.key;
-          break;
-        }
-      }
+  void Train(MemoryRequest *request) {
 
-      // not training phase
-      else {
-        if (entry.sp <= vcla && entry.ep >= vcla) {
-          // HIT! entry within monitor scope
-          hit = true;
-          key = row.key;
-          break;
-        }
-      }
-    }
+    _appCounter[request -> cpuID] ++;
+    _prefetchAddrDistance = Throttle(_distance) * _blockSize;
 
+    addr_t vcla = VBLOCK_ADDRESS(request, _blockSize);
+    addr_t pcla = PBLOCK_ADDRESS(request, _blockSize);
+    
+    // Check if there is a stream entry matching the address: within
+    // training scope of an entry in the training phase, or within monitor
+    // scope of a trained entry
+    uint32 index = FindStream(vcla);
 
     // If there is a stream entry, then update the entry based on
     // the current phase and issue prefetches if necessary
-    if (hit) {
+    if (index != _tableSize) {
+      uint32 key = _keys[index];
+
       // dummy read to update replacement state
       _streamTable.read(key);
       
@@ -322,13 +352,18 @@ protected:
           entry.trained = true;
       }
 
+      // demands in a trained stream confirm it
+      else if (entry.trainHits < 2 * (int)_numTrains) {
+        entry.trainHits ++;
+      }
+
       // entry trained
       if (entry.trained) {
         // Issue prefetches
 
         // update the request entry
         request -> d_prefetched = true;
-        request -> d_prefID = row.index;
+        request -> d_prefID = index;
 
         int32 numPrefetches = 0;
 
@@ -346,24 +381,16 @@ protected:
           addr_t minAddress = entry.sp - (_prefetchAddrDistance + _blockSize);
           maxPrefetches = (entry.ep - minAddress) / _blockSize;
         }
-        numPrefetches = (maxPrefetches < _degree ? maxPrefetches : _degree);
+        uint32 degree = Throttle(_degree);
+        numPrefetches = (maxPrefetches < degree ? maxPrefetches : degree);
+        uint32 confidence = Confidence(entry.trainHits, _numTrains);
 
         for (int32 i = 0; i < numPrefetches; i ++) {
           entry.ep += (entry.direction * _blockSize);
           entry.pep += (entry.direction * _blockSize);
-          MemoryRequest *prefetch =
-            new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
-                              MemoryRequest::PREFETCH, request -> cmpID, 
-                              entry.ep, entry.pep, _blockSize,
-                              request -> currentCycle);
-          prefetch -> icount = request -> icount;
-          prefetch -> ip = request -> ip;
-          prefetch -> prefetcherID = row.index;
-          SendToNextComponent(prefetch);
+          Prefetch(request, entry.ep, entry.pep, index, confidence);
         }
 
-        ADD_TO_COUNTER(num_prefetches, numPrefetches);
-
         // issue fake reads
         int32 numFakes;
 
@@ -377,14 +404,9 @@ protected:
             if (numFakes <= _distance) {
               entry.faked = true;
               for (int32 i = 0; i < numFakes; i ++) {
-                MemoryRequest *fake =
-                  new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
-                                    MemoryRequest::FAKE_READ, request -> cmpID,
-                                    vcurrent, pcurrent, _blockSize,
-                                    request -> currentCycle);
-                fake -> icount = request -> icount;
-                fake -> ip = request -> ip;
-                fake -> prefetcherID = row.index;
+                MemoryRequest *fake = NewRequest(request, MemoryRequest::FAKE_READ,
+                                                 vcurrent, pcurrent);
+                fake -> prefetcherID = index;
                 SendToNextComponent(fake);
                 entry.fake_vp = vcurrent;
                 entry.fake_pp = pcurrent;
@@ -400,14 +422,9 @@ protected:
             if (numFakes <= _distance) {
               entry.faked = true;
               for (int32 i = 0; i < numFakes; i ++) {
-                MemoryRequest *fake =
-                  new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
-                                    MemoryRequest::FAKE_READ, request -> cmpID,
-                                    vcurrent, pcurrent, _blockSize,
-                                    request -> currentCycle);
-                fake -> icount = request -> icount;
-                fake -> ip = request -> ip;
-                fake -> prefetcherID = row.index;
+                MemoryRequest *fake = NewRequest(request, MemoryRequest::FAKE_READ,
+                                                 vcurrent, pcurrent);
+                fake -> prefetcherID = index;
                 entry.fake_vp = vcurrent;
                 entry.fake_pp = pcurrent;
                 SendToNextComponent(fake);
@@ -433,21 +450,13 @@ protected:
         }
       }
 
+      Mirror(index, key, entry);
+
       // Remove redundant stream entry
-      for (uint32 i = 0; i < _tableSize; i ++) {
-        row = _streamTable.entry_at_index(i);
-        if (!row.valid) continue;
-        if (row.key == key) continue;
-
-        if (((entry.direction == FORWARD) &&
-             ((row.value.sp <= entry.ep && row.value.sp >= entry.sp) ||
-              (row.value.ep <= entry.ep && row.value.ep >= entry.sp))) ||
-            ((entry.direction == BACKWARD) &&
-             ((row.value.sp <= entry.sp && row.value.sp >= entry.ep) ||
-              (row.value.ep <= entry.sp && row.value.ep >= entry.ep)))) {
-          _streamTable.invalidate(row.key);
-        }
-      }
+      if (entry.direction == FORWARD)
+        RemoveOverlapping(index, entry.sp, entry.ep);
+      else if (entry.direction == BACKWARD)
+        RemoveOverlapping(index, entry.ep, entry.sp);
     }
     
     // If there is no stream entry, allocate a new stream entry
@@ -472,6 +481,8 @@ protected:
       entry.faked = false;
       entry.direction = NONE;
       evicted = _streamTable.insert(_runningIndex, entry);
+      index = _streamTable.get(_runningIndex).index;
+      Mirror(index, _runningIndex, entry);
       _runningIndex ++;
       
       if (_fake && evicted.valid && evicted.value.trained) {
@@ -484,14 +495,9 @@ protected:
           if (numFakes < _distance) {
             
             for (int32 i = 0; i < numFakes; i ++) {
-              MemoryRequest *fake =
-                new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
-                                  MemoryRequest::FAKE_READ, request -> cmpID,
-                                  vcurrent, pcurrent, _blockSize,
-                                  request -> currentCycle);
-              fake -> icount = request -> icount;
-              fake -> ip = request -> ip;
-              fake -> prefetcherID = row.index;
+              MemoryRequest *fake = NewRequest(request, MemoryRequest::FAKE_READ,
+                                               vcurrent, pcurrent);
+              fake -> prefetcherID = index;
               SendToNextComponent(fake);
               vcurrent += _blockSize;
               pcurrent += _blockSize;
@@ -502,14 +508,9 @@ protected:
           numFakes = (int32)(evicted.value.sp - evicted.value.ep)/_blockSize;
           if (numFakes <= _distance) {
             for (int32 i = 0; i < numFakes; i ++) {
-              MemoryRequest *fake =
-                new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
-                                  MemoryRequest::FAKE_READ, request -> cmpID,
-                                  vcurrent, pcurrent, _blockSize,
-                                  request -> currentCycle);
-              fake -> icount = request -> icount;
-              fake -> ip = request -> ip;
-              fake -> prefetcherID = row.index;
+              MemoryRequest *fake = NewRequest(request, MemoryRequest::FAKE_READ,
+                                               vcurrent, pcurrent);
+              fake -> prefetcherID = index;
               SendToNextComponent(fake);
               vcurrent -= _blockSize;
               pcurrent -= _blockSize;
@@ -519,25 +520,6 @@ protected:
         // printf("-- Enum fakes = %d\n", numFakes);
       }
     }
-      
-    return 0; 
-  }
-
-
-  // -------------------------------------------------------------------------
-  // Function to process the return of a request. Return value indicates
-  // number of busy cycles for the component.
-  // -------------------------------------------------------------------------
-    
-  cycles_t ProcessReturn(MemoryRequest *request) {
-
-    // if its a prefetch/fake from this component, delete it
-    if (request -> iniType == MemoryRequest::COMPONENT &&
-        request -> iniPtr == this) {
-      request -> destroy = true;
-    }
-    
-    return 0; 
   }
 
 };
@@ -11,7 +11,7 @@
 // Module includes
 // -----------------------------------------------------------------------------
 
-#include "MemoryComponent.h"
+#include "CmpPrefetcher.h"
 #include "Types.h"
 #include "GenericTable.h"
 
@@ -25,11 +25,12 @@
 // Class: CmpStridePrefetcher
 // Description:
 // This class implements a simple stride prefetcher. The number
-// of strides to prefetch can be configured
+// of strides to prefetch can be configured. The confidence of the
+// prefetches grows with the accesses that confirmed the stride
 // -----------------------------------------------------------------------------
 
 
-class CmpStridePrefetcher : public MemoryComponent {
+class CmpStridePrefetcher : public CmpPrefetcher {
 
 protected:
 
@@ -37,10 +38,6 @@ protected:
   // Parameters
   // -------------------------------------------------------------------------
 
-  uint32 _degree;
-  uint32 _blockSize;
-  bool _prefetchOnWrite;
-
   uint32 _tableSize;
   string _tablePolicy;
   uint32 _numTrains;
@@ -67,10 +64,11 @@ protected:
     addr_t vpref;
     addr_t ppref;
 
-    // stride length
+    // stride length, in blocks
     int stride;
 
-    // training state
+    // training state. trainHits counts the accesses that confirmed the
+    // stride, up to twice the number of trains
     int trainHits;
     bool trained;
     
@@ -79,13 +77,6 @@ protected:
   generic_table_t <addr_t, StrideEntry> _strideTable;
 
 
-  // -------------------------------------------------------------------------
-  // Declare Counters
-  // -------------------------------------------------------------------------
-
-  NEW_COUNTER(num_prefetches);
-
-
 public:
 
   // -------------------------------------------------------------------------
@@ -93,10 +84,6 @@ public:
   // -------------------------------------------------------------------------
 
   CmpStridePrefetcher() {
-    _degree = 4;
-    _prefetchOnWrite = false;
-    _blockSize = 64;
-		
     _tableSize = 16;
     _tablePolicy = "lru";
 
@@ -119,16 +106,13 @@ public:
     CMP_PARAMETER_BEGIN
 
       // Add the list of parameters to the component here
-      CMP_PARAMETER_UINT("degree", _degree)
-      CMP_PARAMETER_UINT("block-size", _blockSize)
-      CMP_PARAMETER_BOOLEAN("prefetch-on-write", _prefetchOnWrite)	  
       CMP_PARAMETER_UINT("table-size", _tableSize)
       CMP_PARAMETER_STRING("table-policy", _tablePolicy)
       CMP_PARAMETER_UINT("train-distance", _trainDistance)
       CMP_PARAMETER_UINT("num-trains", _numTrains)
       CMP_PARAMETER_UINT("distance", _distance)
 
-    CMP_PARAMETER_END
+    CMP_PARAMETER_PARENT(CmpPrefetcher)
   }
 
 
@@ -137,7 +121,7 @@ public:
   // -------------------------------------------------------------------------
 
   void InitializeStatistics() {
-    INITIALIZE_COUNTER(num_prefetches, "Number of prefetches issued")
+    CmpPrefetcher::InitializeStatistics();
   }
 
 
@@ -146,40 +130,18 @@ public:
   // -------------------------------------------------------------------------
 
   void StartSimulation() {
+    CmpPrefetcher::StartSimulation();
     _strideTable.SetTableParameters(_tableSize, _tablePolicy);
   }
 
 
-  // -------------------------------------------------------------------------
-  // Function called at a heart beat. Argument indicates cycles elapsed after
-  // previous heartbeat
-  // -------------------------------------------------------------------------
-
-  void HeartBeat(cycles_t hbCount) {
-  }
-
-
 protected:
 
   // -------------------------------------------------------------------------
-  // Function to process a request. Return value indicates number of busy
-  // cycles for the component.
+  // Function to train the prefetcher with a demand request
   // -------------------------------------------------------------------------
 
-  cycles_t ProcessRequest(MemoryRequest *request) {
-
-    if (request -> type == MemoryRequest::WRITE ||
-        request -> type == MemoryRequest::WRITEBACK ||
-        request -> type == MemoryRequest::PREFETCH) {
-      // do nothing
-      return 0;
-    }
-
-    if (!_prefetchOnWrite &&
-        (request -> type == MemoryRequest::READ_FOR_WRITE)) {
-      // do nothing
-      return 0;
-    }
+  void Train(MemoryRequest *request) {
 
     addr_t vcla = VBLOCK_ADDRESS(request, _blockSize);
     addr_t pcla = PBLOCK_ADDRESS(request, _blockSize);
@@ -201,15 +163,15 @@ protected:
       // insert the new entry into the table
       _strideTable.insert(request->ip, entry);
       
-      return 0;
+      return;
     }
 		
 
     // Stride table hit. Actual read entry
     StrideEntry &entry = _strideTable[ip];
 		
-    // compute stride
-    int vstride = vcla - entry.vaddr;
+    // compute stride, in blocks
+    int vstride = ((int64)vcla - (int64)entry.vaddr) / (int64)_blockSize;
 
     // if stride mismatch, retrain
     if (entry.stride != vstride) {
@@ -221,9 +183,11 @@ protected:
     entry.vaddr = vcla;
     entry.paddr = pcla;
 
+    if (entry.trainHits < 2 * (int)_numTrains)
+      entry.trainHits ++;
+
     // if entry is not trained, then update vpref and ppref
     if (!entry.trained) {
-      entry.trainHits ++;
       entry.vpref = vcla;
       entry.ppref = pcla;
     }
@@ -234,7 +198,7 @@ protected:
 
     // if stride is 0, no point prefetching
     if (entry.stride == 0)
-      return 0;
+      return;
 
 
     // If entry is trained, issue prefetches.
@@ -242,9 +206,11 @@ protected:
 		  
       // figure out how many prefetches to send
       addr_t maxAddress =
-        entry.vaddr + ((_distance + 1) * entry.stride * _blockSize);
+        entry.vaddr + ((Throttle(_distance) + 1) * entry.stride * _blockSize);
       int maxPrefetches = (maxAddress - entry.vpref)/_blockSize;
-      int numPrefetches = (maxPrefetches > _degree) ? _degree : maxPrefetches;
+      uint32 degree = Throttle(_degree);
+      int numPrefetches = (maxPrefetches > degree) ? degree : maxPrefetches;
+      uint32 confidence = Confidence(entry.trainHits, _numTrains);
 
       // issue prefetches
       for (int i = 0; i < numPrefetches; i ++) {
@@ -253,40 +219,10 @@ protected:
         entry.vpref += _blockSize * entry.stride;
         entry.ppref += _blockSize * entry.stride;
 
-        // generate memory request
-        MemoryRequest *prefetch =
-          new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
-                            MemoryRequest::PREFETCH, request -> cmpID, 
-                            entry.vpref, entry.ppref, _blockSize,
-                            request -> currentCycle);
-        prefetch -> icount = request -> icount;
-        prefetch -> ip = request -> ip;
-
         // send the prefetch request downstream
-        SendToNextComponent(prefetch);
+        Prefetch(request, entry.vpref, entry.ppref, 0, confidence);
       }
-		
-      ADD_TO_COUNTER(num_prefetches, numPrefetches);
-    }
-
-    return 0;
-  }
-
-
-  // -------------------------------------------------------------------------
-  // Function to process the return of a request. Return value indicates
-  // number of busy cycles for the component.
-  // -------------------------------------------------------------------------
-    
-  cycles_t ProcessReturn(MemoryRequest *request) {
-
-    // if its a prefetch from this component, delete it
-    if (request -> iniType == MemoryRequest::COMPONENT &&
-        request -> iniPtr == this) {
-      request -> destroy = true;
     }
-    
-    return 0; 
   }
 
 };
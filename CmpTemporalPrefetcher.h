@@ -0,0 +1,501 @@
+// -----------------------------------------------------------------------------
+// File: CmpTemporalPrefetcher.h
+// Description:
+//    Defines a temporal correlation prefetcher, similar to sampled temporal
+//    memory streaming (STMS). The misses seen by the prefetcher are appended
+//    to a circular history, and an index maps each block to its last
+//    position in the history. On a miss to a block in the index, the blocks
+//    that followed it in the history (its successors) are prefetched.
+//
+//    The history and the index are kept in memory, in a metadata region
+//    (metadata-region). By default, each temporal prefetcher takes the
+//    next region in the order of the definition, so that per-core
+//    prefetchers do not share their metadata blocks. The metadata traffic
+//    is simulated: the metadata requests go down the hierarchy like the
+//    other requests of the component, so they take bandwidth and cache
+//    space below the prefetcher. They are marked as metadata, so that the
+//    levels below do not count them as demands.
+//
+//    - history entries take 8 bytes. They are written one block at a time,
+//      when the block being filled on chip is complete
+//    - index entries take 8 bytes, in blocks hashed by block address. The
+//      prefetcher caches index-cache index blocks on chip. A miss in the
+//      cache reads the index block, and a dirty index block is written
+//      back when it leaves the cache. Only one in index-sampling misses
+//      updates the index
+//    - a miss to a block of a stream advances it. Other misses look up the
+//      index, and start a stream at the position found. A
+//      stream prefetches degree successors ahead of the last miss in it,
+//      reading the history blocks it has not read yet. The successors in
+//      the block being filled on chip need no read
+//    - the confidence of the prefetches of a stream grows with the misses
+//      that hit it: 25 for a new stream, 100 after three hits
+// -----------------------------------------------------------------------------
+
+#ifndef __CMP_TEMPORAL_PREFETCHER_H__
+#define __CMP_TEMPORAL_PREFETCHER_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "CmpPrefetcher.h"
+#include "GenericTable.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <map>
+
+// metadata regions are laid out from the top of the address space, one per
+// metadata-region, away from the addresses of the traces
+#define TEMPORAL_METADATA_BASE 0xFFFF000000000000ULL
+#define TEMPORAL_METADATA_REGION (1ULL << 36)
+#define TEMPORAL_ENTRY_BYTES 8
+
+
+// -----------------------------------------------------------------------------
+// Class: CmpTemporalPrefetcher
+// Description:
+// This class implements a temporal correlation prefetcher with its metadata
+// in memory.
+// -----------------------------------------------------------------------------
+
+class CmpTemporalPrefetcher : public CmpPrefetcher {
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Parameters
+  // -------------------------------------------------------------------------
+
+  uint32 _historySize;
+  uint32 _indexSize;
+  uint32 _indexCacheSize;
+  uint32 _numStreams;
+  uint32 _indexSampling;
+  uint32 _metadataRegion;
+
+
+  // -------------------------------------------------------------------------
+  // Private members
+  // -------------------------------------------------------------------------
+
+  struct HistoryEntry {
+    addr_t vcla;
+    addr_t pcla;
+  };
+
+  // a replay waiting for metadata
+  enum ReplayStage {
+    INDEX_READ,
+    HISTORY_READ
+  };
+
+  // a replay prefetches the positions from first to last, with the
+  // confidence of its stream. An index read starts a stream at position
+  // first - 1 when it returns
+  struct Replay {
+    ReplayStage stage;
+    uint64 first;
+    uint64 last;
+    uint32 confidence;
+  };
+
+  // a stream follows the history. last is the position of the last miss
+  // in the stream, the positions up to prefetched are prefetched, and the
+  // history blocks before unread are read. hits counts the misses in the
+  // stream, up to 3
+  struct Stream {
+    uint64 last;
+    uint64 prefetched;
+    uint64 unread;
+    uint32 hits;
+  };
+
+  // history, and the position of its next entry
+  vector <HistoryEntry> _history;
+  uint64 _head;
+
+  // last position of the blocks, and the index blocks cached on chip
+  // (dirty or not)
+  generic_table_t <addr_t, uint64> _index;
+  generic_table_t <uint64, bool> _indexCache;
+
+  // metadata reads in flight
+  map <MemoryRequest *, Replay> _replays;
+
+  // streams, replaced in LRU order
+  generic_table_t <uint32, Stream> _streams;
+  uint32 _nextStream;
+
+  uint32 _entriesPerBlock;
+  uint64 _indexBlocks;
+  addr_t _historyBase;
+  addr_t _indexBase;
+
+
+  // -------------------------------------------------------------------------
+  // Declare Counters
+  // -------------------------------------------------------------------------
+
+  NEW_COUNTER(triggers);
+  NEW_COUNTER(stream_hits);
+  NEW_COUNTER(index_cache_hits);
+  NEW_COUNTER(metadata_reads);
+  NEW_COUNTER(metadata_writes);
+
+
+public:
+
+  // -------------------------------------------------------------------------
+  // Constructor. It cannot take any arguments
+  // -------------------------------------------------------------------------
+
+  CmpTemporalPrefetcher() {
+    _historySize = 262144;
+    _indexSize = 262144;
+    _indexCacheSize = 256;
+    _numStreams = 8;
+    _indexSampling = 8;
+    _metadataRegion = Instances() ++;
+
+    _degree = 16;
+
+    // successors are on other pages
+    _pageSize = 0;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Virtual functions to be implemented by the components
+  // -------------------------------------------------------------------------
+
+  // -------------------------------------------------------------------------
+  // Function to add a parameter to the component
+  // -------------------------------------------------------------------------
+
+  void AddParameter(string pname, string pvalue) {
+
+    CMP_PARAMETER_BEGIN
+
+      // Add the list of parameters to the component here
+      CMP_PARAMETER_UINT("history-size", _historySize)
+      CMP_PARAMETER_UINT("index-size", _indexSize)
+      CMP_PARAMETER_UINT("index-cache-size", _indexCacheSize)
+      CMP_PARAMETER_UINT("streams", _numStreams)
+      CMP_PARAMETER_UINT("index-sampling", _indexSampling)
+      CMP_PARAMETER_UINT("metadata-region", _metadataRegion)
+
+    CMP_PARAMETER_PARENT(CmpPrefetcher)
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to initialize statistics
+  // -------------------------------------------------------------------------
+
+  void InitializeStatistics() {
+    CmpPrefetcher::InitializeStatistics();
+    INITIALIZE_COUNTER(triggers, "Streams started")
+    INITIALIZE_COUNTER(stream_hits, "Misses in a stream")
+    INITIALIZE_COUNTER(index_cache_hits, "Index cache hits")
+    INITIALIZE_COUNTER(metadata_reads, "Metadata block reads")
+    INITIALIZE_COUNTER(metadata_writes, "Metadata block writes")
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function called when simulation starts
+  // -------------------------------------------------------------------------
+
+  void StartSimulation() {
+    CmpPrefetcher::StartSimulation();
+
+    HistoryEntry empty = {0, 0};
+    _history.assign(_historySize, empty);
+    _head = 0;
+
+    _index.SetTableParameters(_indexSize, "lru");
+    _indexCache.SetTableParameters(_indexCacheSize, "lru");
+    _streams.SetTableParameters(_numStreams, "lru");
+    _nextStream = 0;
+
+    _entriesPerBlock = _blockSize / TEMPORAL_ENTRY_BYTES;
+    _indexBlocks = ((uint64)_indexSize + _entriesPerBlock - 1) /
+      _entriesPerBlock;
+    _historyBase = TEMPORAL_METADATA_BASE +
+      _metadataRegion * TEMPORAL_METADATA_REGION;
+    _indexBase = _historyBase +
+      BLOCK_ADDRESS((uint64)_historySize * TEMPORAL_ENTRY_BYTES +
+                    _blockSize - 1, _blockSize);
+  }
+
+
+protected:
+
+  // -------------------------------------------------------------------------
+  // Function to count the temporal prefetchers created
+  // -------------------------------------------------------------------------
+
+  static uint32 &Instances() {
+    static uint32 instances = 0;
+    return instances;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions to get the metadata blocks of history positions and blocks
+  // -------------------------------------------------------------------------
+
+  addr_t HistoryBlock(uint64 position) {
+    return _historyBase +
+      ((position % _historySize) / _entriesPerBlock) * _blockSize;
+  }
+
+  addr_t IndexBlock(addr_t pcla) {
+    uint64 hash = ((pcla / _blockSize) * 0x9E3779B97F4A7C15ULL) >> 16;
+    return _indexBase + (hash % _indexBlocks) * _blockSize;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Functions to send a metadata read or write. A read returns the request,
+  // which is NULL on the functional path since it does not return
+  // -------------------------------------------------------------------------
+
+  MemoryRequest *ReadMetadata(MemoryRequest *trigger, addr_t block) {
+    MemoryRequest *read = NewRequest(trigger, MemoryRequest::READ, block, block);
+    read -> metadata = true;
+    INCREMENT(metadata_reads);
+    SendToNextComponent(read);
+    return (_functional ? NULL : read);
+  }
+
+  void WriteMetadata(MemoryRequest *trigger, addr_t block) {
+    MemoryRequest *write =
+      NewRequest(trigger, MemoryRequest::WRITEBACK, block, block);
+    write -> metadata = true;
+    INCREMENT(metadata_writes);
+    SendToNextComponent(write);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to bring an index block to the index cache. Returns true if it
+  // is there already. The block it replaces is written back if dirty
+  // -------------------------------------------------------------------------
+
+  bool CacheIndex(MemoryRequest *trigger, addr_t block, bool dirty) {
+    if (_indexCache.lookup(block)) {
+      INCREMENT(index_cache_hits);
+      _indexCache.read(block);
+      if (dirty)
+        _indexCache[block] = true;
+      return true;
+    }
+
+    table_t <uint64, bool>::entry evicted;
+    evicted = _indexCache.insert(block, dirty);
+    if (evicted.valid && evicted.value)
+      WriteMetadata(trigger, evicted.key);
+    return false;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to check that a position is still in the history
+  // -------------------------------------------------------------------------
+
+  bool InHistory(uint64 position) {
+    return (position < _head && position + _historySize >= _head);
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to prefetch the positions from first to last that are still in
+  // the history
+  // -------------------------------------------------------------------------
+
+  void PrefetchSuccessors(MemoryRequest *trigger, uint64 first, uint64 last,
+                          uint32 confidence) {
+    for (uint64 p = first; p <= last; p ++) {
+      if (!InHistory(p))
+        continue;
+      HistoryEntry &entry = _history[p % _historySize];
+      Prefetch(trigger, entry.vcla, entry.pcla, 0, confidence);
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to advance a stream to degree successors after a position. The
+  // successors in history blocks already read are prefetched right away,
+  // the others when their block returns
+  // -------------------------------------------------------------------------
+
+  void Advance(MemoryRequest *trigger, Stream &stream, uint64 position) {
+    uint64 last = position + Throttle(_degree);
+    if (last >= _head)
+      last = _head - 1;
+    uint32 confidence = Confidence(stream.hits + 1, 2);
+
+    while (stream.prefetched < last) {
+      uint64 first = stream.prefetched + 1;
+      uint64 block = first / _entriesPerBlock;
+      uint64 end = (block + 1) * _entriesPerBlock - 1;
+      if (end > last)
+        end = last;
+      stream.prefetched = end;
+
+      // block read already, or the block being filled on chip
+      if (block < stream.unread || block == _head / _entriesPerBlock) {
+        PrefetchSuccessors(trigger, first, end, confidence);
+        continue;
+      }
+
+      stream.unread = block + 1;
+      MemoryRequest *read = ReadMetadata(trigger, HistoryBlock(first));
+      if (read == NULL) {
+        PrefetchSuccessors(trigger, first, end, confidence);
+        continue;
+      }
+      Replay replay = {HISTORY_READ, first, end, confidence};
+      _replays[read] = replay;
+    }
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to start a stream after a position
+  // -------------------------------------------------------------------------
+
+  void StartStream(MemoryRequest *trigger, uint64 position) {
+    if (!InHistory(position + 1))
+      return;
+    INCREMENT(triggers);
+
+    Stream stream;
+    stream.last = position;
+    stream.prefetched = position;
+    stream.unread = position / _entriesPerBlock;
+    stream.hits = 0;
+    _streams.insert(_nextStream, stream);
+    Advance(trigger, _streams[_nextStream], position);
+    _nextStream ++;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to find the stream with a block among its prefetched
+  // successors. Returns false if there is none
+  // -------------------------------------------------------------------------
+
+  bool FindStream(addr_t pcla, uint32 &key, uint64 &position) {
+    for (uint32 i = 0; i < _numStreams; i ++) {
+      table_t <uint32, Stream>::entry row = _streams.entry_at_index(i);
+      if (!row.valid)
+        continue;
+      for (uint64 p = row.value.last + 1; p <= row.value.prefetched; p ++) {
+        if (InHistory(p) && _history[p % _historySize].pcla == pcla) {
+          key = row.key;
+          position = p;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to train the prefetcher with a demand request
+  // -------------------------------------------------------------------------
+
+  void Train(MemoryRequest *request) {
+
+    addr_t vcla = VBLOCK_ADDRESS(request, _blockSize);
+    addr_t pcla = PBLOCK_ADDRESS(request, _blockSize);
+
+    // a miss in a stream advances it
+    uint32 key;
+    uint64 position;
+    if (FindStream(pcla, key, position)) {
+      INCREMENT(stream_hits);
+      _streams.read(key);
+      _streams[key].last = position;
+      if (_streams[key].hits < 3)
+        _streams[key].hits ++;
+      Advance(request, _streams[key], position);
+    }
+
+    // others look up the index. The stream starts when the index block is
+    // read, on a miss in the index cache
+    else {
+      bool cached = CacheIndex(request, IndexBlock(pcla), false);
+      MemoryRequest *indexRead = NULL;
+      if (!cached)
+        indexRead = ReadMetadata(request, IndexBlock(pcla));
+
+      if (_index.lookup(pcla)) {
+        position = _index.read(pcla).value;
+        if (indexRead != NULL) {
+          Replay replay = {INDEX_READ, position + 1, position + 1, 0};
+          _replays[indexRead] = replay;
+        }
+        else {
+          StartStream(request, position);
+        }
+      }
+    }
+
+    // append the miss to the history
+    HistoryEntry &entry = _history[_head % _historySize];
+    entry.vcla = vcla;
+    entry.pcla = pcla;
+
+    if (_indexSampling != 0 && _head % _indexSampling == 0) {
+      if (!CacheIndex(request, IndexBlock(pcla), true))
+        ReadMetadata(request, IndexBlock(pcla));
+      if (_index.lookup(pcla))
+        _index[pcla] = _head;
+      else
+        _index.insert(pcla, _head);
+    }
+    _head ++;
+
+    if (_head % _entriesPerBlock == 0)
+      WriteMetadata(request, HistoryBlock(_head - 1));
+  }
+
+
+  // -------------------------------------------------------------------------
+  // Function to process the return of a request. Return value indicates
+  // number of busy cycles for the component.
+  // -------------------------------------------------------------------------
+
+  cycles_t ProcessReturn(MemoryRequest *request) {
+
+    if (request -> iniType == MemoryRequest::COMPONENT &&
+        request -> iniPtr == this) {
+      map <MemoryRequest *, Replay>::iterator replay = _replays.find(request);
+      if (replay != _replays.end()) {
+        Replay pending = replay -> second;
+        _replays.erase(replay);
+        if (pending.stage == INDEX_READ)
+          StartStream(request, pending.first - 1);
+        else
+          PrefetchSuccessors(request, pending.first, pending.last,
+                             pending.confidence);
+      }
+    }
+
+    return CmpPrefetcher::ProcessReturn(request);
+  }
+
+};
+
+#endif // __CMP_TEMPORAL_PREFETCHER_H__
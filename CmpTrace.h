@@ -1,7 +1,9 @@
 // -----------------------------------------------------------------------------
 // File: CmpTrace.h
 // Description:
-//    A sample component to dump traces.
+//    A sample component to dump traces. The traces are chunked (see
+//    TraceIndex.h), gzip text lines by default. With the columnar format,
+//    the records are delta-encoded in columns (see TraceColumns.h).
 // -----------------------------------------------------------------------------
 
 #ifndef __CMP_TRACE_H__
@@ -12,14 +14,9 @@
 // -----------------------------------------------------------------------------
 
 #include "MemoryComponent.h"
+#include "TraceIndex.h"
 #include "Types.h"
 
-// -----------------------------------------------------------------------------
-// Standard includes
-// -----------------------------------------------------------------------------
-
-#include <zlib.h>
-
 
 // -----------------------------------------------------------------------------
 // Class: CmpTrace
@@ -36,12 +33,14 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     string _traceFileName;
+    string _codec;
+    string _format;
 
     // -------------------------------------------------------------------------
     // Private members
     // -------------------------------------------------------------------------
 
-    gzFile _trace;
+    ChunkedTraceWriter *_trace;
 
 
   public:
@@ -52,6 +51,9 @@ class CmpTrace : public MemoryComponent {
 
     CmpTrace() {
       _traceFileName = "trace";
+      _codec = "gzip";
+      _format = "text";
+      _trace = NULL;
     }
 
 
@@ -74,6 +76,8 @@ class CmpTrace : public MemoryComponent {
     void AddParameter(string pname, string pvalue) {
       CMP_PARAMETER_BEGIN
       CMP_PARAMETER_STRING("trace-file-name", _traceFileName)
+      CMP_PARAMETER_STRING("codec", _codec)
+      CMP_PARAMETER_STRING("format", _format)
       CMP_PARAMETER_END
     }
 
@@ -82,9 +86,24 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void StartSimulation() {
-      string fileName = _simulationFolderName + "/" + _traceFileName + ".gz";
-      _trace = gzopen64(fileName.c_str(), "w");
-      assert (_trace != Z_NULL);
+      int32 codec = TraceCodecFromName(_codec);
+      if (codec < 0) {
+        fprintf(stderr, "Unknown trace codec `%s'\n", _codec.c_str());
+        exit(1);
+      }
+      uint32 layout = TRACE_LAYOUT_TEXT;
+      if (_format == "columnar") {
+        layout = TRACE_LAYOUT_COLUMNAR;
+      }
+      else if (_format != "text") {
+        fprintf(stderr, "Unknown trace format `%s'\n", _format.c_str());
+        exit(1);
+      }
+      bool gzip = (codec == TRACE_CODEC_GZIP && layout == TRACE_LAYOUT_TEXT);
+      string fileName = _simulationFolderName + "/" + _traceFileName +
+        (gzip ? ".gz" : ".trc");
+      _trace = new ChunkedTraceWriter(fileName, TRACE_CHUNK_RECORDS, codec,
+                                      layout);
     }
 
 
@@ -93,7 +112,9 @@ class CmpTrace : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void EndSimulation() {
-      gzclose(_trace);
+      _trace -> Close();
+      delete _trace;
+      _trace = NULL;
     }
 
 
@@ -106,6 +127,15 @@ class CmpTrace : public MemoryComponent {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Functional path. Only the simulated requests are traced
+    // -------------------------------------------------------------------------
+
+    bool WarmAccess(MemoryRequest *request) {
+      return false;
+    }
+
+
   protected:
 
     // -------------------------------------------------------------------------
@@ -115,9 +145,15 @@ class CmpTrace : public MemoryComponent {
 
     cycles_t ProcessRequest(MemoryRequest *request) {
       if (!_warmUp) {
-        gzprintf(_trace, "%llu %llu %llu %llu %u %u\n", request -> icount,
-            request -> ip, request -> virtualAddress, 
-            request -> physicalAddress, request -> size, request -> type);
+        TraceRecord record;
+        record.icount = request -> icount;
+        record.ip = request -> ip;
+        record.virtualAddress = request -> virtualAddress;
+        record.physicalAddress = request -> physicalAddress;
+        record.size = request -> size;
+        record.type = request -> type;
+        record.dep = 0;
+        _trace -> Write(record);
       }
       return 0; 
     }
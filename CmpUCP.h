@@ -39,6 +39,7 @@ class CmpUCP : public MemoryComponent {
     uint32 _tagStoreLatency;
     uint32 _dataStoreLatency;
     uint32 _partitionPeriod; 
+    uint32 _monitorSets;
 
     // -------------------------------------------------------------------------
     // Private members
@@ -47,20 +48,36 @@ class CmpUCP : public MemoryComponent {
     struct TagEntry {
       bool valid;
       bool dirty;
+      uint32 cpuID;
       addr_t ctag;
       addr_t vcla;
       addr_t pcla;
+      uint64 lastAccess;
       TagEntry() { valid = false; dirty = false; }
     };
 
+    // entry of the auxiliary tag directory of a cpu
+    struct MonitorEntry {
+      bool valid;
+      addr_t ctag;
+      MonitorEntry() { valid = false; }
+    };
+
     uint32 _numSets;
     vector <uint32> _target;
     vector <vector <uint32> > _current;
     vector <vector <uint32> > _hits;
     vector <uint32> _misses;
     vector <uint32> _free;
-    vector <vector <vector <TagEntry> > > _tags;
+    vector <vector <TagEntry> > _tags;
     vector <vector <uint32> > _utility;
+    uint64 _accessCount;
+
+    // the utility of each cpu is measured on an auxiliary tag directory
+    // that keeps the blocks the cpu would have in the cache if it had it
+    // alone. only one in every _monitorStride sets is monitored
+    vector <vector <vector <MonitorEntry> > > _monitor;
+    uint32 _monitorStride;
 
     cycles_t _previousPartitionCycle;
 
@@ -94,6 +111,7 @@ class CmpUCP : public MemoryComponent {
       _tagStoreLatency = 1;
       _dataStoreLatency = 2;
       _partitionPeriod = 5000000;
+      _monitorSets = 32;
     }
 
 
@@ -116,6 +134,7 @@ class CmpUCP : public MemoryComponent {
       CMP_PARAMETER_UINT("tag-store-latency", _tagStoreLatency)
       CMP_PARAMETER_UINT("data-store-latency", _dataStoreLatency)
       CMP_PARAMETER_UINT("partition-period", _partitionPeriod)
+      CMP_PARAMETER_UINT("monitor-sets", _monitorSets)
 
       CMP_PARAMETER_END
     }
@@ -144,24 +163,39 @@ class CmpUCP : public MemoryComponent {
     // -------------------------------------------------------------------------
 
     void StartSimulation() {
+      // every cpu keeps at least one way
+      if (_numCPUs > _associativity) {
+        fprintf(stderr, "Error: UCP `%s' has %u ways for %u cpus\n",
+                _name.c_str(), _associativity, _numCPUs);
+        exit(-1);
+      }
+
       _numSets = (_size * 1024) / (_blockSize * _associativity);
       _target.resize(_numCPUs, _associativity/_numCPUs);
       _free.resize(_numSets, _associativity);
+      _accessCount = 0;
       
       _current.resize(_numSets);
-      for (uint32 i = 0; i < _numSets; i ++) 
+      _tags.resize(_numSets);
+      for (uint32 i = 0; i < _numSets; i ++) {
         _current[i].resize(_numCPUs, 0);
+        _tags[i].resize(_associativity);
+      }
+
+      if (_monitorSets == 0 || _monitorSets > _numSets)
+        _monitorSets = _numSets;
+      _monitorStride = _numSets / _monitorSets;
 
-      _tags.resize(_numCPUs);
+      _monitor.resize(_numCPUs);
       _hits.resize(_numCPUs);
       _utility.resize(_numCPUs);
       _misses.resize(_numCPUs, 0);
       for (uint32 i = 0; i < _numCPUs; i ++) {
         _hits[i].resize(_associativity, 0);
         _utility[i].resize(_associativity);
-        _tags[i].resize(_numSets);
-        for (uint32 j = 0; j < _numSets; j ++) {
-          _tags[i][j].resize(_associativity);
+        _monitor[i].resize(_monitorSets);
+        for (uint32 j = 0; j < _monitorSets; j ++) {
+          _monitor[i][j].resize(_associativity);
         }
       }
 
@@ -330,67 +364,83 @@ class CmpUCP : public MemoryComponent {
     }
 
     // -------------------------------------------------------------------------
-    // Function to check if a block is present. On a hit update the replacement
-    // policy and the hit counters
+    // Function to update the auxiliary tag directory of a cpu if the set is
+    // monitored. A hit updates the hit counter of its recency position
     // -------------------------------------------------------------------------
-    
-    bool CheckBlock(uint32 cpuID, addr_t ctag) {
-      
-      uint32 index = Index(ctag);
-      for (uint32 way = 0; way < _associativity; way ++) {
-
-        if (_tags[cpuID][index][way].ctag == ctag) {
 
-          // Update hit counters
-          _hits[cpuID][way] ++;
+    void Monitor(uint32 cpuID, addr_t ctag) {
 
-          // TRUE HIT
-          if (_tags[cpuID][index][way].valid) {
-            TagEntry temp = _tags[cpuID][index][way];
-            for (int32 i = way;  i > 0; i --) {
-              _tags[cpuID][index][i] = _tags[cpuID][index][i - 1];
-            }
-            _tags[cpuID][index][0] = temp;
-            return true;
-          }
+      uint32 index = Index(ctag);
+      if (index % _monitorStride != 0 || index / _monitorStride >= _monitorSets)
+        return;
 
-          // FALSE HIT
-          _misses[cpuID] ++;
-          return false;
-        }
+      vector <MonitorEntry> &entries = _monitor[cpuID][index / _monitorStride];
+      uint32 way;
+      for (way = 0; way < _associativity - 1; way ++) {
+        if (entries[way].valid && entries[way].ctag == ctag)
+          break;
       }
 
-      _misses[cpuID] ++;
-      return false;
+      if (entries[way].valid && entries[way].ctag == ctag)
+        _hits[cpuID][way] ++;
+
+      // move the block to the most recently used position
+      for (int32 i = way; i > 0; i --)
+        entries[i] = entries[i - 1];
+      entries[0].valid = true;
+      entries[0].ctag = ctag;
     }
 
 
     // -------------------------------------------------------------------------
-    // Function to mark a block as dirty if its present
+    // Function to find the way of a block in its set. Returns the
+    // associativity if the block is not present
     // -------------------------------------------------------------------------
 
-    bool MarkDirty(uint32 cpuID, addr_t ctag) {
-
+    uint32 FindBlock(addr_t ctag) {
       uint32 index = Index(ctag);
       for (uint32 way = 0; way < _associativity; way ++) {
+        if (_tags[index][way].valid && _tags[index][way].ctag == ctag)
+          return way;
+      }
+      return _associativity;
+    }
 
-        if (_tags[cpuID][index][way].ctag == ctag) {
 
-          // Update hit counters
-          _hits[cpuID][way] ++;
+    // -------------------------------------------------------------------------
+    // Function to check if a block is present. On a hit update the replacement
+    // policy
+    // -------------------------------------------------------------------------
+    
+    bool CheckBlock(uint32 cpuID, addr_t ctag) {
 
-          // TRUE HIT
-          if (_tags[cpuID][index][way].valid) {
-            _tags[cpuID][index][way].dirty = true;
-            return true;
-          }
+      Monitor(cpuID, ctag);
 
-          // FALSE HIT
-          return false;
-        }
+      uint32 way = FindBlock(ctag);
+      if (way == _associativity) {
+        _misses[cpuID] ++;
+        return false;
       }
 
-      return false;
+      _tags[Index(ctag)][way].lastAccess = ++ _accessCount;
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to mark a block as dirty if its present
+    // -------------------------------------------------------------------------
+
+    bool MarkDirty(uint32 cpuID, addr_t ctag) {
+
+      Monitor(cpuID, ctag);
+
+      uint32 way = FindBlock(ctag);
+      if (way == _associativity)
+        return false;
+
+      _tags[Index(ctag)][way].dirty = true;
+      return true;
     }
 
 
@@ -402,6 +452,8 @@ class CmpUCP : public MemoryComponent {
         addr_t pcla, MemoryRequest *request) {
 
       uint32 index = Index(ctag);
+      vector <TagEntry> &set = _tags[index];
+      uint32 way;
 
       // check if some block needs to be evicted
       if (_free[index] == 0) {
@@ -422,27 +474,35 @@ class CmpUCP : public MemoryComponent {
           victim = cpuID;
         }
 
-        // evict a line from the victim
-        EvictBlock(_tags[victim][index][_current[index][victim] - 1], request);
-        _tags[victim][index][_current[index][victim] - 1].valid = false;
+        // evict the least recently used line of the victim
+        way = _associativity;
+        for (uint32 i = 0; i < _associativity; i ++) {
+          if (set[i].cpuID == victim &&
+              (way == _associativity || set[i].lastAccess < set[way].lastAccess))
+            way = i;
+        }
+        assert(way < _associativity);
+
+        EvictBlock(set[way], request);
         _current[index][victim] --;
         _occupancy[victim] --;
       }
 
       else {
+        for (way = 0; way < _associativity; way ++)
+          if (!set[way].valid)
+            break;
         _free[index] --;
       }
 
-      // insert the block into the required cpu
-      for (int32 i = _associativity - 1; i > 0; i --) {
-        _tags[cpuID][index][i] = _tags[cpuID][index][i - 1];
-      }
-
-      _tags[cpuID][index][0].valid = true;
-      _tags[cpuID][index][0].dirty = dirty;
-      _tags[cpuID][index][0].ctag = ctag;
-      _tags[cpuID][index][0].vcla = vcla;
-      _tags[cpuID][index][0].pcla = pcla;
+      // insert the block into the way
+      set[way].valid = true;
+      set[way].dirty = dirty;
+      set[way].cpuID = cpuID;
+      set[way].ctag = ctag;
+      set[way].vcla = vcla;
+      set[way].pcla = pcla;
+      set[way].lastAccess = ++ _accessCount;
       _current[index][cpuID] ++;
       _occupancy[cpuID] ++;
     }
@@ -26,6 +26,10 @@
 #include "CmpNextLinePrefetcher.h"
 #include "CmpStreamPrefetcher.h"
 #include "CmpStridePrefetcher.h"
+#include "CmpSMSPrefetcher.h"
+#include "CmpSPPPrefetcher.h"
+#include "CmpTemporalPrefetcher.h"
+#include "CmpPrefetchBuffer.h"
 
 // DCP
 #include "CmpDCP.h"
@@ -75,6 +79,10 @@ MemoryComponent *CreateComponent(string type) {
     COMPONENT("next-line-prefetcher", CmpNextLinePrefetcher)
     COMPONENT("stream-prefetcher", CmpStreamPrefetcher)
     COMPONENT("stride-prefetcher", CmpStridePrefetcher)
+    COMPONENT("sms-prefetcher", CmpSMSPrefetcher)
+    COMPONENT("spp-prefetcher", CmpSPPPrefetcher)
+    COMPONENT("temporal-prefetcher", CmpTemporalPrefetcher)
+    COMPONENT("prefetch-buffer", CmpPrefetchBuffer)
 
     // DCP
     COMPONENT("dcp", CmpDCP)
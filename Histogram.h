@@ -0,0 +1,182 @@
+// -----------------------------------------------------------------------------
+// File: Histogram.h
+// Description:
+//    This file defines a log-bucketed histogram (HDR-style) used to record
+//    latency distributions with a bounded relative error.
+// -----------------------------------------------------------------------------
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Class: log_histogram_t
+// Description:
+//    Values below 2^subBits get a bucket each. Every power-of-two range above
+//    that is split into 2^subBits linear sub-buckets, so the relative error of
+//    any recorded value is at most 2^-subBits.
+// -----------------------------------------------------------------------------
+
+class log_histogram_t {
+
+protected:
+
+  // ---------------------------------------------------------------------------
+  // Parameters
+  // ---------------------------------------------------------------------------
+
+  uint32 _subBits;
+
+  // ---------------------------------------------------------------------------
+  // Private members
+  // ---------------------------------------------------------------------------
+
+  vector <uint64> _buckets;
+  uint64 _count;
+  uint64 _sum;
+  uint64 _max;
+
+
+  // ---------------------------------------------------------------------------
+  // Function to compute the bucket of a value
+  // ---------------------------------------------------------------------------
+
+  uint32 index(uint64 value) {
+    if (value < (1ULL << _subBits))
+      return value;
+    uint32 msb = 63 - __builtin_clzll(value);
+    uint32 shift = msb - _subBits;
+    return ((shift + 1) << _subBits) +
+      (uint32)((value >> shift) - (1ULL << _subBits));
+  }
+
+
+public:
+
+  // ---------------------------------------------------------------------------
+  // Constructor
+  // ---------------------------------------------------------------------------
+
+  log_histogram_t(uint32 subBits = 4) {
+    initialize(subBits);
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Initialize
+  // ---------------------------------------------------------------------------
+
+  void initialize(uint32 subBits) {
+    assert(subBits > 0 && subBits < 16);
+    _subBits = subBits;
+    _buckets.assign((64 - _subBits + 1) << _subBits, 0);
+    reset();
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Clear all recorded values
+  // ---------------------------------------------------------------------------
+
+  void reset() {
+    fill(_buckets.begin(), _buckets.end(), 0);
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Record a value
+  // ---------------------------------------------------------------------------
+
+  void add(uint64 value) {
+    _buckets[index(value)] ++;
+    _count ++;
+    _sum += value;
+    if (value > _max) _max = value;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Lowest and highest values that map to a bucket
+  // ---------------------------------------------------------------------------
+
+  uint64 lower_bound(uint32 bucket) {
+    if (bucket < (1U << _subBits))
+      return bucket;
+    uint32 shift = (bucket >> _subBits) - 1;
+    return ((uint64)(bucket & ((1U << _subBits) - 1)) +
+            (1ULL << _subBits)) << shift;
+  }
+
+  uint64 upper_bound(uint32 bucket) {
+    if (bucket < (1U << _subBits))
+      return bucket;
+    uint32 shift = (bucket >> _subBits) - 1;
+    return lower_bound(bucket) + (1ULL << shift) - 1;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Summary statistics
+  // ---------------------------------------------------------------------------
+
+  uint64 count() { return _count; }
+  uint64 max() { return _max; }
+
+  uint64 mean() {
+    if (_count == 0) return 0;
+    return _sum / _count;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Value at a percentile (0-100). Returns the highest value equivalent to
+  // the bucket holding the percentile, capped at the recorded maximum.
+  // ---------------------------------------------------------------------------
+
+  uint64 percentile(double p) {
+    if (_count == 0) return 0;
+    uint64 target = (uint64)((p / 100.0) * _count + 0.5);
+    if (target == 0) target = 1;
+    uint64 seen = 0;
+    for (uint32 i = 0; i < _buckets.size(); i ++) {
+      seen += _buckets[i];
+      if (seen >= target)
+        return (upper_bound(i) < _max ? upper_bound(i) : _max);
+    }
+    return _max;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Dump the non-empty buckets as "low high count" lines
+  // ---------------------------------------------------------------------------
+
+  void dump(FILE *file, const char *prefix = "") {
+    for (uint32 i = 0; i < _buckets.size(); i ++) {
+      if (_buckets[i] == 0) continue;
+      fprintf(file, "%s%llu %llu %llu\n", prefix, lower_bound(i),
+              upper_bound(i), _buckets[i]);
+    }
+  }
+};
+
+#endif // __HISTOGRAM_H__
@@ -24,7 +24,6 @@
 #include <list>
 #include <cstdio>
 #include <string>
-#include <bitset>
 #include <queue>
 #include <map>
 
@@ -69,6 +68,12 @@ using namespace std;
     exit(-1);\
   }
 
+// ends the parameters of a derived component. the others go to its parent
+#define CMP_PARAMETER_PARENT(parent) \
+  else {\
+    parent::AddParameter(pname, pvalue);\
+  }
+
 #define CMP_PARAMETER_INT(name,var) \
   else if (pname.compare(name) == 0) {\
     int32 ret;\
@@ -201,6 +206,20 @@ typedef priority_queue <MemoryRequest *, vector <MemoryRequest *>,
 
 // priority_queue is a pre-existing type, present in the std namespace
 
+
+// -----------------------------------------------------------------------------
+// Requests leaving the private levels of a cpu on the functional path. While
+// active, the private levels of each cpu are warmed on their own thread and
+// the requests that reach the first shared level are deferred here
+// -----------------------------------------------------------------------------
+
+struct WarmDeferral {
+  uint32 level;
+  bool active;
+  vector <MemoryRequest *> requests;
+  WarmDeferral() { level = 0; active = false; }
+};
+
 // -----------------------------------------------------------------------------
 // Class: MemoryComponent
 // Description:
@@ -229,14 +248,21 @@ class MemoryComponent {
     bool _processing;
     // warm up flag, true if in warm up phase
     bool _warmUp;
+    // true while the component processes a request on the functional path
+    bool _functional;
     // pointer to the simulator cycle
     cycles_t *_simulatorCycle;
+    // pointer to the simulator count of requests added to the components
+    uint64 *_activity;
     // pointer to the memory hierarchy
     vector <vector <MemoryComponent *> > *_hier;
+    // pointer to the functional path deferrals of the cpus
+    vector <WarmDeferral> *_deferral;
     // number of cpus
     uint32 _numCPUs;
 
-  bitset <128> _done;
+    // cpus that have finished their simulation
+    vector <bool> _done;
 
     // simulation folder
     string _simulationFolderName;
@@ -253,6 +279,9 @@ class MemoryComponent {
     };
     map <string, Stats> _stats;
     list <string> _statsOrder;
+    // counters saved around the functional path
+    vector <uint64 *> _counterPtrs;
+    vector <uint64> _savedCounters;
 
     // log files
     map <string, FILE *> _logs;
@@ -270,10 +299,12 @@ class MemoryComponent {
       _currentCycle = 0;
       _processing = false;
       _warmUp = true;
+      _functional = false;
+      _deferral = NULL;
+      _activity = NULL;
       _stats.clear();
       _statsOrder.clear();
       _logs.clear();
-      _done.reset();
     }
 
 
@@ -298,6 +329,7 @@ class MemoryComponent {
 	_queue.pop();
 	(request -> currentCycle) += 15;
 	_queue.push(request);
+	if (_activity) (*_activity) ++;
     }
 
 
@@ -326,12 +358,22 @@ class MemoryComponent {
 // This function sets the simulator cycle and hierarchy pointers to the global simcycle and hierarchy 
 
     void SetBackPointers(vector <vector <MemoryComponent *> > *hier,
-        cycles_t *simCycle) {
+        cycles_t *simCycle, uint64 *activity) {
       // set the pointers for the simulator cycle and hierarchy
       _hier = hier;
       _simulatorCycle = simCycle;
+      _activity = activity;
       _numCPUs = (*hier).size();
-      _done.reset();
+      _done.assign(_numCPUs, false);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the back pointer for the functional path deferrals
+    // -------------------------------------------------------------------------
+
+    void SetWarmDeferral(vector <WarmDeferral> *deferral) {
+      _deferral = deferral;
     }
 
 
@@ -352,6 +394,7 @@ class MemoryComponent {
 
     void AddRequest(MemoryRequest *request) {
       _queue.push(request);
+      if (_activity) (*_activity) ++;
       if (!_processing)
         ProcessPendingRequests();
 	
@@ -363,6 +406,7 @@ class MemoryComponent {
     // ------------------------------------------------------------------------
     void SimpleAddRequest(MemoryRequest *request) {
       _queue.push(request);
+      if (_activity) (*_activity) ++;
       	
     }
 
@@ -443,7 +487,7 @@ class MemoryComponent {
     }
 
     virtual void EndProcSimulation(uint32 cpuID) {
-      _done.set(cpuID);
+      _done[cpuID] = true;
     }
 
 
@@ -457,6 +501,98 @@ class MemoryComponent {
     virtual void HeartBeat(cycles_t hbCount) {}
 
 
+    // -------------------------------------------------------------------------
+    // Functional path used to warm up the components without timing. Access
+    // updates the state for a request going down the hierarchy and returns
+    // true if the request is serviced by the component. Return is called on
+    // the way back up. The default runs ProcessRequest and ProcessReturn
+    // with the requests they generate sent down the functional path, and
+    // leaves the counters unchanged. Components override them with a
+    // cheaper path that only updates their tags and predictors
+    // -------------------------------------------------------------------------
+
+    virtual bool WarmAccess(MemoryRequest *request) {
+      SaveCounters();
+      _functional = true;
+      ProcessRequest(request);
+      _functional = false;
+      RestoreCounters();
+      request -> stalling = false;
+      return request -> serviced;
+    }
+
+    virtual void WarmReturn(MemoryRequest *request) {
+      SaveCounters();
+      _functional = true;
+      ProcessReturn(request);
+      _functional = false;
+      RestoreCounters();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to send a request through the functional path of a hierarchy
+    // starting at the given level. With an active deferral, a copy of the
+    // request is deferred when it reaches the shared levels
+    // -------------------------------------------------------------------------
+
+    static void WarmHierarchy(vector <MemoryComponent *> &hier,
+                              MemoryRequest *request, uint32 first,
+                              WarmDeferral *deferral = NULL) {
+      uint32 last = hier.size();
+      if (deferral != NULL && deferral -> active)
+        last = deferral -> level;
+
+      uint32 level;
+      for (level = first; level < last; level ++) {
+        request -> cmpID = level;
+        if (hier[level] -> WarmAccess(request))
+          break;
+      }
+      if (level == last && last < hier.size()) {
+        MemoryRequest *shared = new MemoryRequest(*request);
+        shared -> cmpID = last;
+        deferral -> requests.push_back(shared);
+      }
+      while (level > first) {
+        level --;
+        request -> cmpID = level;
+        hier[level] -> WarmReturn(request);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the value of a counter. Returns false if the component
+    // has no such counter
+    // -------------------------------------------------------------------------
+
+    bool GetCounter(string name, uint64 &value) {
+      if (_stats.find(name) == _stats.end())
+        return false;
+      value = *(_stats[name].ptr);
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to append the values of all the counters to a list, and to
+    // set them from a list starting at the given index
+    // -------------------------------------------------------------------------
+
+    void AppendCounters(vector <uint64> &values) {
+      map <string, Stats>::iterator it;
+      for (it = _stats.begin(); it != _stats.end(); it ++)
+        values.push_back(*((*it).second.ptr));
+    }
+
+    void SetCounters(const vector <uint64> &values, uint32 &index) {
+      map <string, Stats>::iterator it;
+      for (it = _stats.begin(); it != _stats.end(); it ++)
+        *((*it).second.ptr) = values[index ++];
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to process pending requests. Different components can choose to
     // override this function. The default implementation processes one request
@@ -495,6 +631,7 @@ Access the request according to age.
         if (_currentCycle > (*_simulatorCycle)) {
           request -> currentCycle = _currentCycle;
           _queue.push(request);
+          request = _queue.top();
         }
 
         // else process the request
@@ -549,6 +686,64 @@ Access the request according to age.
     virtual cycles_t ProcessReturn(MemoryRequest *request) { return 0; }
 
 
+    // -------------------------------------------------------------------------
+    // Function to get the functional path deferral of a cpu
+    // -------------------------------------------------------------------------
+
+    WarmDeferral *Deferral(uint32 cpuID) {
+      if (_deferral == NULL)
+        return NULL;
+      return &((*_deferral)[cpuID]);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to save and restore the counters around the functional path.
+    // The pointers to the counters are collected once, and the values are
+    // saved into a buffer kept with the component
+    // -------------------------------------------------------------------------
+
+    void SaveCounters() {
+      if (_counterPtrs.size() != _stats.size()) {
+        _counterPtrs.clear();
+        map <string, Stats>::iterator it;
+        for (it = _stats.begin(); it != _stats.end(); it ++)
+          _counterPtrs.push_back((*it).second.ptr);
+        _savedCounters.resize(_counterPtrs.size());
+      }
+      for (uint32 i = 0; i < _counterPtrs.size(); i ++)
+        _savedCounters[i] = *(_counterPtrs[i]);
+    }
+
+    void RestoreCounters() {
+      for (uint32 i = 0; i < _counterPtrs.size(); i ++)
+        *(_counterPtrs[i]) = _savedCounters[i];
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write back an evicted block on the functional path. The
+    // writeback goes down the hierarchy below the request's component before
+    // the request continues
+    // -------------------------------------------------------------------------
+
+    void WarmWriteback(MemoryRequest *request, addr_t vcla, addr_t pcla,
+                       uint32 size, bool dirty) {
+      if ((uint32)(request -> cmpID + 1) == (*_hier)[request -> cpuID].size())
+        return;
+      MemoryRequest *writeback =
+        new MemoryRequest(MemoryRequest::COMPONENT, request -> cpuID, this,
+                          MemoryRequest::WRITEBACK, request -> cmpID,
+                          vcla, pcla, size, request -> currentCycle);
+      writeback -> dirtyReply = dirty;
+      writeback -> icount = request -> icount;
+      writeback -> ip = request -> ip;
+      WarmHierarchy((*_hier)[request -> cpuID], writeback,
+                    request -> cmpID + 1, Deferral(request -> cpuID));
+      delete writeback;
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to send the request to the next component. It uses the serviced
     // flag in the request to determine the direction of the request.
@@ -556,6 +751,20 @@ Access the request according to age.
 
     void SendToNextComponent(MemoryRequest *request) {
 
+      // on the functional path, the requests generated by the component go
+      // down the hierarchy right away. the request being processed is left
+      // to the functional path
+      if (_functional) {
+        if (request -> iniType == MemoryRequest::COMPONENT &&
+            request -> iniPtr == this) {
+          if (!request -> destroy)
+            WarmHierarchy((*_hier)[request -> cpuID], request,
+                          request -> cmpID + 1, Deferral(request -> cpuID));
+          delete request;
+        }
+        return;
+      }
+
       // if the request should be destroyed, delete it
       if (request -> destroy) {
         delete request;
@@ -18,6 +18,7 @@
 // Standard includes
 // -----------------------------------------------------------------------------
 
+#include <cstddef>
 
 // -----------------------------------------------------------------------------
 // Structure: MemoryRequest
@@ -54,10 +55,23 @@ struct MemoryRequest {
   uint32 size;
   // instruction count of the request
   uint64 icount;
+  // instruction count of the earlier request producing this request's
+  // address. 0 if independent
+  uint64 depIcount;
   // issue cycle of the request
   cycles_t issueCycle;
-  // id of the prefetcher if prefetched
+  // prefetcher component and id of the prefetcher if prefetched
+  void *prefetcher;
   uint32 prefetcherID;
+  // caches a prefetch is filled into: all the caches it returns through,
+  // only the last-level cache, the private caches with low priority (and
+  // the last-level cache normally), or only a prefetch buffer
+  enum FillLevel {
+    FILL_ALL,
+    FILL_LLC,
+    FILL_LOW,
+    FILL_BUFFER
+  } fillLevel;
   
 
   
@@ -105,6 +119,12 @@ struct MemoryRequest {
   // which they hit. Set to max sets if its a victim set miss
   bool reuseVictim;
   uint32 victimSetID;
+  // dropped. set by the memory controller when it drops a prefetch instead
+  // of fetching it. the MSHR that issued the miss must not fill the block
+  bool dropped;
+  // metadata. set on the requests a prefetcher sends for its own metadata
+  // in memory. they are not demands
+  bool metadata;
 
   // ---------------------------------------------------------------------------
   // Constructor
@@ -117,6 +137,11 @@ struct MemoryRequest {
     serviced = false;
     finished = false;
     dirtyReply = false;
+    dropped = false;
+    metadata = false;
+    depIcount = 0;
+    prefetcher = NULL;
+    fillLevel = FILL_ALL;
     d_prefetched = false;
     d_hit = false;
     s_f_d = false;
@@ -143,6 +168,11 @@ struct MemoryRequest {
     serviced = false;
     finished = false;
     dirtyReply = false;
+    dropped = false;
+    metadata = false;
+    depIcount = 0;
+    prefetcher = NULL;
+    fillLevel = FILL_ALL;
     d_prefetched = false;
     d_hit = false;
     s_f_d = false;
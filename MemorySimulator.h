@@ -21,6 +21,7 @@
 // -----------------------------------------------------------------------------
 
 #include <list>
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
 #include <sstream>
@@ -45,6 +46,8 @@ class MemorySimulator {
     uint32 _numCPUs;
     // hierarchy of components for each processor
     vector <vector <MemoryComponent *> > _hier;
+    // functional path deferrals at the first shared level of each processor
+    vector <WarmDeferral> _deferral;
 
     // simulation folder name
     string _simulationFolderName;
@@ -53,6 +56,11 @@ class MemorySimulator {
 
     // current time of the simulator
     cycles_t _currentCycle;
+    // requests added to the components, and the count when the components
+    // were last processed at the current time. a sweep at the same time
+    // with no new requests cannot make progress
+    uint64 _activity;
+    uint64 _sweptActivity;
 
   public:
 
@@ -66,6 +74,8 @@ class MemorySimulator {
       _hier.clear();
       _numCPUs = 0;
       _currentCycle = 0;
+      _activity = 0;
+      _sweptActivity = 0;
     }
 
 
@@ -78,6 +88,7 @@ class MemorySimulator {
       // initialize members
       _numCPUs = numCPUs;
       _hier.resize(numCPUs);
+      _deferral.resize(numCPUs);
       _simulationFolderName = simulationFolderName;
       // open the simulator log file
       string logFileName = simulationFolderName + "/SimulationLog";
@@ -109,7 +120,8 @@ class MemorySimulator {
       // hierarchy and current cycle
       list <MemoryComponent *>::iterator cmp;
       for (cmp = _components.begin(); cmp != _components.end(); cmp ++) {
-        (*cmp) -> SetBackPointers(&_hier, &_currentCycle);
+        (*cmp) -> SetBackPointers(&_hier, &_currentCycle, &_activity);
+        (*cmp) -> SetWarmDeferral(&_deferral);
         (*cmp) -> SetLogDetails(_simulationFolderName, _simulationLog);
         (*cmp) -> InitializeStatistics();
         (*cmp) -> StartSimulation();
@@ -127,13 +139,17 @@ class MemorySimulator {
      
 	// This is done by the AutoAdvance function
       if (now > _currentCycle)	_currentCycle = now;
+      else if (_activity == _sweptActivity) return;
 	//cout << "current cycle of memory simulator is " << _currentCycle << endl;
 	
-      // Process pending requests of all the components
+      // Process pending requests of all the components. requests added
+      // during the sweep are processed by the next one
+      uint64 activity = _activity;
       list <MemoryComponent *>::iterator cmp;
       for (cmp = _components.begin(); cmp != _components.end(); cmp ++) {
         (*cmp) -> ProcessPendingRequests();
       }
+      _sweptActivity = activity;
     }
 
 
@@ -255,6 +271,7 @@ class MemorySimulator {
     // -------------------------------------------------------------------------
 
     void HeartBeat(cycles_t hbCount) {
+      _activity ++;
       list <MemoryComponent *>::iterator cmp;
       for (cmp = _components.begin(); cmp != _components.end(); cmp ++)
         (*cmp) -> HeartBeat(hbCount);
@@ -302,6 +319,144 @@ class MemorySimulator {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to warm up the hierarchy of the cpu with a request on the
+    // functional path. The request is not timed and is not retained
+    // -------------------------------------------------------------------------
+
+    void WarmAccess(MemoryRequest *request) {
+
+      assert((uint32)request -> cpuID < _numCPUs);
+
+      if (_hier.size() == 0 || _hier[request -> cpuID].size() == 0)
+        return;
+
+      MemoryComponent::WarmHierarchy(_hier[request -> cpuID], request, 0,
+                                     &_deferral[request -> cpuID]);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to check if the processors have private levels that can be
+    // warmed in parallel. A level is private if its component is in the
+    // hierarchy of only one processor
+    // -------------------------------------------------------------------------
+
+    bool HasPrivateLevels() {
+      bool found = false;
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        uint32 level;
+        for (level = 0; level < _hier[i].size(); level ++) {
+          bool shared = false;
+          for (uint32 j = 0; j < _numCPUs; j ++) {
+            if (j == i) continue;
+            if (find(_hier[j].begin(), _hier[j].end(), _hier[i][level]) !=
+                _hier[j].end())
+              shared = true;
+          }
+          if (shared)
+            break;
+        }
+        _deferral[i].level = level;
+        if (level > 0)
+          found = true;
+      }
+      return found;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to start or stop deferring the requests that reach the shared
+    // levels on the functional path. While deferring, the private levels of
+    // different processors can be warmed concurrently
+    // -------------------------------------------------------------------------
+
+    void DeferSharedLevels(bool active) {
+      for (uint32 i = 0; i < _numCPUs; i ++)
+        _deferral[i].active = active;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to warm the shared levels with the deferred requests of all
+    // processors, in instruction order
+    // -------------------------------------------------------------------------
+
+    static bool EarlierIcount(const MemoryRequest *a, const MemoryRequest *b) {
+      return (a -> icount < b -> icount);
+    }
+
+    void WarmSharedLevels() {
+      vector <MemoryRequest *> requests;
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        requests.insert(requests.end(), _deferral[i].requests.begin(),
+                        _deferral[i].requests.end());
+        _deferral[i].requests.clear();
+      }
+      stable_sort(requests.begin(), requests.end(), EarlierIcount);
+
+      for (uint32 r = 0; r < requests.size(); r ++) {
+        MemoryComponent::WarmHierarchy(_hier[requests[r] -> cpuID],
+                                       requests[r], requests[r] -> cmpID,
+                                       &_deferral[requests[r] -> cpuID]);
+        delete requests[r];
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the value of a counter from all the components that
+    // have it
+    // -------------------------------------------------------------------------
+
+    void GetCounters(string counter, vector <pair <string, uint64> > &values) {
+      values.clear();
+      list <MemoryComponent *>::iterator cmp;
+      for (cmp = _components.begin(); cmp != _components.end(); cmp ++) {
+        uint64 value;
+        if ((*cmp) -> GetCounter(counter, value))
+          values.push_back(make_pair((*cmp) -> Name(), value));
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to get and set the values of all the counters of all the
+    // components
+    // -------------------------------------------------------------------------
+
+    void GetAllCounters(vector <uint64> &values) {
+      values.clear();
+      list <MemoryComponent *>::iterator cmp;
+      for (cmp = _components.begin(); cmp != _components.end(); cmp ++)
+        (*cmp) -> AppendCounters(values);
+    }
+
+    void SetAllCounters(const vector <uint64> &values) {
+      uint32 index = 0;
+      list <MemoryComponent *>::iterator cmp;
+      for (cmp = _components.begin(); cmp != _components.end(); cmp ++)
+        (*cmp) -> SetCounters(values, index);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the cpus whose hierarchy contains a component
+    // -------------------------------------------------------------------------
+
+    void GetComponentCPUs(string name, vector <uint32> &cpus) {
+      cpus.clear();
+      for (uint32 i = 0; i < _hier.size(); i ++) {
+        for (uint32 level = 0; level < _hier[i].size(); level ++) {
+          if (_hier[i][level] -> Name() == name) {
+            cpus.push_back(i);
+            break;
+          }
+        }
+      }
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to parse the simulator configuration
     // -------------------------------------------------------------------------
@@ -48,6 +48,20 @@ int main(int argc, char **argv) {
   bool synthetic = false;
   uint32 workingSetSize = 0;
   uint32 memGap = 50;
+  vector <string> syntheticSpecs;
+  uint64 sliceStart = 0;
+  uint64 sliceEnd = 0;
+  uint32 traceThreads = 0;
+  uint32 issueWidth = 1;
+  uint32 lqSize = 0;
+  uint32 sqSize = 0;
+  bool dependencies = false;
+  uint64 samplePeriod = 0;
+  uint64 sampleUnit = 0;
+  uint64 sampleWarmUp = 0;
+  string simpointFile("");
+  bool functionalWarmUp = false;
+  uint64 parallelQuantum = 0;
   
 
   struct option cmd_options[] = {
@@ -62,6 +76,20 @@ int main(int argc, char **argv) {
     {"ooo-window", required_argument, 0, 'i'},
     {"synthetic", required_argument, 0, 'k'},
     {"mem-gap", required_argument, 0, 'm'},
+    {"issue-width", required_argument, 0, 'n'},
+    {"lq-size", required_argument, 0, 'o'},
+    {"sq-size", required_argument, 0, 'p'},
+    {"dependencies", no_argument, 0, 'q'},
+    {"sample-period", required_argument, 0, 'r'},
+    {"sample-unit", required_argument, 0, 's'},
+    {"sample-warm-up", required_argument, 0, 't'},
+    {"simpoints", required_argument, 0, 'u'},
+    {"functional-warm-up", no_argument, 0, 'v'},
+    {"parallel-quantum", required_argument, 0, 'w'},
+    {"synthetic-spec", required_argument, 0, 'x'},
+    {"trace-slice", required_argument, 0, 'y'},
+    {"trace-threads", required_argument, 0, 'z'},
+    {0, 0, 0, 0}
   };
 
   int c = 0;
@@ -157,6 +185,93 @@ int main(int argc, char **argv) {
       memGap = atoi(optarg);
       break;
 
+      // -----------------------------------------------------------------------
+      // core model. the reorder buffer size is the ooo window
+      // -----------------------------------------------------------------------
+      case 'n':
+        issueWidth = atoi(optarg);
+        break;
+
+      case 'o':
+        lqSize = atoi(optarg);
+        break;
+
+      case 'p':
+        sqSize = atoi(optarg);
+        break;
+
+      case 'q':
+        dependencies = true;
+        break;
+
+      // -----------------------------------------------------------------------
+      // sampled simulation. a sample unit of 0 simulates everything
+      // -----------------------------------------------------------------------
+      case 'r':
+        samplePeriod = atoll(optarg);
+        break;
+
+      case 's':
+        sampleUnit = atoll(optarg);
+        break;
+
+      case 't':
+        sampleWarmUp = atoll(optarg);
+        break;
+
+      case 'u':
+        simpointFile = optarg;
+        break;
+
+      // -----------------------------------------------------------------------
+      // warm up on the functional path of the memory simulator
+      // -----------------------------------------------------------------------
+      case 'v':
+        functionalWarmUp = true;
+        break;
+
+      // -----------------------------------------------------------------------
+      // instructions per quantum when the private levels are warmed in
+      // parallel. 0 warms on a single thread
+      // -----------------------------------------------------------------------
+      case 'w':
+        parallelQuantum = atoll(optarg);
+        break;
+
+      // -----------------------------------------------------------------------
+      // synthetic spec files, one per cpu
+      // -----------------------------------------------------------------------
+      case 'x':
+        synthetic = true;
+        trString = optarg;
+        index = 0;
+        next = trString.find_first_of(",", index);
+        while (next != string::npos) {
+          syntheticSpecs.push_back(trString.substr(index, next-index));
+          index = next + 1;
+          next = trString.find_first_of(",", index);
+        }
+        syntheticSpecs.push_back(trString.substr(index));
+        break;
+
+      // -----------------------------------------------------------------------
+      // slice of the traces, start[:end] in instructions
+      // -----------------------------------------------------------------------
+      case 'y':
+        trString = optarg;
+        index = trString.find_first_of(":");
+        sliceStart = atoll(trString.substr(0, index).c_str());
+        if (index != string::npos)
+          sliceEnd = atoll(trString.substr(index + 1).c_str());
+        break;
+
+      // -----------------------------------------------------------------------
+      // threads decompressing chunked traces
+      // -----------------------------------------------------------------------
+      case 'z':
+        traceThreads = atoi(optarg);
+        break;
+
       // -----------------------------------------------------------------------
       // wrong option
       // -----------------------------------------------------------------------
@@ -173,6 +288,13 @@ int main(int argc, char **argv) {
                              simulatorConfiguration, oooWindow, traceFiles,
                              folder, synthetic, workingSetSize, memGap);
 
+  traceSim.SetCoreModel(issueWidth, lqSize, sqSize, dependencies);
+  traceSim.SetSampling(samplePeriod, sampleUnit, sampleWarmUp, simpointFile);
+  traceSim.SetFunctionalWarmUp(functionalWarmUp);
+  traceSim.SetParallelQuantum(parallelQuantum);
+  traceSim.SetSyntheticSpecs(syntheticSpecs);
+  traceSim.SetTraceSlice(sliceStart, sliceEnd);
+  traceSim.SetTraceThreads(traceThreads);
   traceSim.StartSimulation();
   traceSim.RunSimulation(warmUp, runTime, heartBeat);
   return 0;
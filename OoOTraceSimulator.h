@@ -4,7 +4,15 @@
 //    Defines an trace simulator with a crude out-of-order model. It assumes all
 //    instructions are independent. All non-memory instructions take 1 cycle to
 //    complete and the latency of the memory instruction is determined by the
-//    memory simulator.
+//    memory simulator. Optionally, the core retires issue-width instructions
+//    per cycle, bounds the in-flight loads and stores by the load and store
+//    queue sizes, and holds a request until the request producing its
+//    address (from the trace) has completed. In sampling mode, the trace is
+//    fast-forwarded on the functional path of the memory simulator and only
+//    periodic sampling units (or SimPoint regions) are simulated in detail.
+//    With a parallel quantum, the functional path warms the private levels
+//    of each processor on its own thread, and the shared levels in between
+//    quanta.
 // -----------------------------------------------------------------------------
 
 
@@ -20,6 +28,7 @@
 #include "TraceReader.h"
 #include "Types.h"
 #include "SyntheticTrace.h"
+#include "RingBuffer.h"
 
 
 // -----------------------------------------------------------------------------
@@ -28,17 +37,22 @@
 
 #include <algorithm>
 #include <set>
+#include <map>
 #include <vector>
 #include <string>
-#include <bitset>
 #include <queue>
 #include <list>
 #include <iostream>
+#include <cmath>
+#include <pthread.h>
 
 #define WARM_UP 0
 #define HEART_BEAT 1
 #define END_SIMULATION 2
 
+// z-value of the confidence interval reported for sampled estimates (95%)
+#define SAMPLE_CONFIDENCE_Z 1.96
+
 
 using namespace std;
 
@@ -51,8 +65,10 @@ using namespace std;
 //    - simulator definition (to pass to the memory simulator)
 //    - simulator configuration (to pass to the memory simulator)
 //    - number of cpus
-//    - trace files
-//    - out-of-order window
+//    - trace files, or synthetic traces (working set or spec files)
+//    - out-of-order window (reorder buffer size)
+//    - core model: issue width, load/store queue sizes, dependencies
+//    - sampling: period, unit size, detailed warm-up, SimPoint regions
 // -----------------------------------------------------------------------------
 
 class OoOTraceSimulator {
@@ -68,10 +84,27 @@ class OoOTraceSimulator {
     string _simulationFolder;
     uint32 _numCPUs;
     vector <string> _traceFiles;
+    uint64 _sliceStart;
+    uint64 _sliceEnd;
     uint32 _oooWindow;
   bool _synthetic;
   uint32 _workingSetSize;
   uint32 _memGap;
+  vector <string> _syntheticSpecs;
+
+    uint32 _issueWidth;
+    uint32 _lqSize;
+    uint32 _sqSize;
+    bool _dependencies;
+
+    bool _sampling;
+    uint64 _samplePeriod;
+    uint64 _sampleUnit;
+    uint64 _sampleWarmUp;
+    string _simpointFile;
+
+    bool _functionalWarmUp;
+    uint64 _parallelQuantum;
 
     // -------------------------------------------------------------------------
     // Private members
@@ -90,8 +123,23 @@ class OoOTraceSimulator {
       // checkpoint at finish
       uint64 finishIcount;
       cycles_t finishCycle;
-      // list of outstanding requests
-      list <MemoryRequest *> outstanding;
+      // next icount reported in the progress file
+      uint64 progressIcount;
+      // outstanding requests in program order. the first dispatched entries
+      // are in the window, the rest are fetched from the trace ahead
+      ring_buffer_t <MemoryRequest *> outstanding;
+      uint32 dispatched;
+      // loads and stores in the window
+      uint32 loads;
+      uint32 stores;
+      // icounts of dispatched requests that have not completed, and requests
+      // waiting for them (by producer icount)
+      set <uint64> pending;
+      multimap <uint64, MemoryRequest *> waiting;
+      // core model statistics
+      uint64 dependentRequests;
+      uint64 lqStalls;
+      uint64 sqStalls;
     };
 
     MemorySimulator _simulator;
@@ -116,8 +164,324 @@ class OoOTraceSimulator {
     // progress file
     FILE *_progress;
 
+    // sampling units. the units are simulated in detail after fast-forwarding
+    // to their start, and their results are kept for the estimates
+    struct SampleUnit {
+      uint64 start;
+      double weight;
+      vector <uint64> icount;
+      vector <cycles_t> cycles;
+      vector <pair <string, uint64> > misses;
+    };
+
+    vector <SampleUnit> _units;
+    vector <pair <string, uint64> > _unitMisses;
+
+    // counters of the components at the start of the current unit, and
+    // their sum over the units simulated so far
+    vector <uint64> _unitCounters;
+    vector <uint64> _sampledCounters;
+
+    // true while the in-flight requests are drained after a unit
+    bool _draining;
+
+    // argument of the threads fast-forwarding the processors
+    struct FastForwardThread {
+      OoOTraceSimulator *sim;
+      uint32 cpuID;
+      uint64 icount;
+    };
+
 #define PROGRESS_LEAP 10000000
 
+// number of requests read from the trace at a time
+#define FETCH_BATCH 32
+
+
+    // -------------------------------------------------------------------------
+    // Core model helpers
+    // -------------------------------------------------------------------------
+
+    bool IsLoad(MemoryRequest *request) {
+      return (request -> type == MemoryRequest::READ);
+    }
+
+    bool IsStore(MemoryRequest *request) {
+      return (request -> type == MemoryRequest::WRITE ||
+              request -> type == MemoryRequest::PARTIALWRITE);
+    }
+
+    // cycles to retire a number of non-memory instructions
+    cycles_t InstCycles(uint64 insts) {
+      return (insts + _issueWidth - 1) / _issueWidth;
+    }
+
+    // cycle at which a request enters the window, i.e., when the retirement
+    // reaches the instruction a window behind it
+    cycles_t FetchCycle(uint32 cpuID, uint64 icount) {
+      ProcInfo &proc = _procs[cpuID];
+      if (icount >= proc.currentIcount + _oooWindow)
+        return proc.currentCycle +
+          InstCycles(icount - proc.currentIcount - _oooWindow);
+      cycles_t back = InstCycles(proc.currentIcount + _oooWindow - icount);
+      return (proc.currentCycle > back ? proc.currentCycle - back : 0);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to check if the next request of a processor can enter the
+    // window
+    // -------------------------------------------------------------------------
+
+    bool WindowHasRoom(uint32 cpuID) {
+      if (_draining)
+        return false;
+
+      ProcInfo &proc = _procs[cpuID];
+      MemoryRequest *next = proc.outstanding[proc.dispatched];
+
+      if (next -> icount - proc.outstanding.front() -> icount >= _oooWindow)
+        return false;
+      if (_lqSize != 0 && IsLoad(next) && proc.loads >= _lqSize) {
+        proc.lqStalls ++;
+        return false;
+      }
+      if (_sqSize != 0 && IsStore(next) && proc.stores >= _sqSize) {
+        proc.sqStalls ++;
+        return false;
+      }
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read the next batch of requests of a processor from its
+    // trace
+    // -------------------------------------------------------------------------
+
+    void Fetch(uint32 cpuID) {
+      ProcInfo &proc = _procs[cpuID];
+      for (uint32 i = 0; i < FETCH_BATCH; i ++) {
+        MemoryRequest *request;
+        if (_synthetic)
+          request = proc.sreader -> NextRequest();
+        else
+          request = proc.reader -> NextRequest();
+        if (request == NULL)
+          break;
+        proc.outstanding.push_back(request);
+      }
+
+      if (proc.dispatched == proc.outstanding.size()) {
+        fprintf(stderr, "No requests from processor %u\n", cpuID);
+        exit(1);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to fill the empty window of a processor starting at its
+    // current cycle
+    // -------------------------------------------------------------------------
+
+    void FillWindow(uint32 cpuID) {
+      ProcInfo &proc = _procs[cpuID];
+
+      MemoryRequest *request = proc.outstanding[proc.dispatched];
+      request -> issueCycle = proc.currentCycle;
+      request -> currentCycle = proc.currentCycle;
+
+      // while there is room in the out-of-order window
+      while (WindowHasRoom(cpuID)) {
+
+        Dispatch(cpuID, proc.outstanding[proc.dispatched]);
+        proc.dispatched ++;
+
+        // get the next requests
+        if (proc.dispatched == proc.outstanding.size())
+          Fetch(cpuID);
+
+        request = proc.outstanding[proc.dispatched];
+        request -> issueCycle = proc.currentCycle +
+          InstCycles(request -> icount - proc.currentIcount);
+        request -> currentCycle = request -> issueCycle;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to fast-forward all processors to an instruction. The requests
+    // before it are sent through the functional path of the memory simulator,
+    // one processor at a time
+    // -------------------------------------------------------------------------
+
+    void FastForward(uint64 icount) {
+
+      if (_parallelQuantum != 0 && _numCPUs > 1 &&
+          _simulator.HasPrivateLevels()) {
+        FastForwardParallel(icount);
+        return;
+      }
+
+      bool progress = true;
+      while (progress) {
+        progress = false;
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          ProcInfo &proc = _procs[i];
+          assert(proc.dispatched == 0);
+
+          MemoryRequest *request = proc.outstanding.front();
+          if (request -> icount >= icount) {
+            proc.currentIcount = max(proc.currentIcount, icount);
+            continue;
+          }
+
+          proc.outstanding.pop_front();
+          _simulator.WarmAccess(request);
+          proc.currentIcount = request -> icount;
+          delete request;
+
+          if (proc.outstanding.empty())
+            Fetch(i);
+          progress = true;
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to fast-forward one processor to an instruction
+    // -------------------------------------------------------------------------
+
+    void FastForwardProc(uint32 cpuID, uint64 icount) {
+      ProcInfo &proc = _procs[cpuID];
+      assert(proc.dispatched == 0);
+
+      while (proc.outstanding.front() -> icount < icount) {
+        MemoryRequest *request = proc.outstanding.front();
+        proc.outstanding.pop_front();
+        _simulator.WarmAccess(request);
+        proc.currentIcount = request -> icount;
+        delete request;
+
+        if (proc.outstanding.empty())
+          Fetch(cpuID);
+      }
+      proc.currentIcount = max(proc.currentIcount, icount);
+    }
+
+    static void *FastForwardThreadMain(void *arg) {
+      FastForwardThread *thread = (FastForwardThread *)arg;
+      thread -> sim -> FastForwardProc(thread -> cpuID, thread -> icount);
+      return NULL;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to fast-forward all processors to an instruction in parallel.
+    // In each quantum, every processor warms its private levels on its own
+    // thread and defers its requests to the shared levels. The shared levels
+    // are then warmed with the deferred requests in instruction order
+    // -------------------------------------------------------------------------
+
+    void FastForwardParallel(uint64 icount) {
+
+      vector <pthread_t> threads(_numCPUs);
+      vector <FastForwardThread> args(_numCPUs);
+
+      uint64 bound = icount;
+      for (uint32 i = 0; i < _numCPUs; i ++)
+        bound = min(bound, _procs[i].currentIcount);
+
+      while (bound < icount) {
+        bound = min(icount, bound + _parallelQuantum);
+
+        _simulator.DeferSharedLevels(true);
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          args[i].sim = this;
+          args[i].cpuID = i;
+          args[i].icount = bound;
+          if (pthread_create(&threads[i], NULL, FastForwardThreadMain,
+                             &args[i]) != 0) {
+            fprintf(stderr, "Cannot create fast-forward thread\n");
+            exit(1);
+          }
+        }
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          pthread_join(threads[i], NULL);
+        _simulator.DeferSharedLevels(false);
+
+        _simulator.WarmSharedLevels();
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to dispatch a request that entered the window. It is held if
+    // the request producing its address is still in flight
+    // -------------------------------------------------------------------------
+
+    void Dispatch(uint32 cpuID, MemoryRequest *request) {
+      ProcInfo &proc = _procs[cpuID];
+
+      if (IsLoad(request)) proc.loads ++;
+      else if (IsStore(request)) proc.stores ++;
+
+      if (_dependencies) {
+        bool held = (request -> depIcount != 0 &&
+                     proc.pending.find(request -> depIcount) !=
+                     proc.pending.end());
+        proc.pending.insert(request -> icount);
+        if (held) {
+          proc.waiting.insert(make_pair(request -> depIcount, request));
+          proc.dependentRequests ++;
+          return;
+        }
+      }
+
+      Issue(cpuID, request);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to issue a request to the memory simulator
+    // -------------------------------------------------------------------------
+
+    void Issue(uint32 cpuID, MemoryRequest *request) {
+      _queue.push(request);
+      _simulator.ProcessMemoryRequest(request);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called when a request completes. Issues the requests waiting
+    // for it
+    // -------------------------------------------------------------------------
+
+    void Complete(uint32 cpuID, MemoryRequest *request) {
+      if (!_dependencies)
+        return;
+
+      ProcInfo &proc = _procs[cpuID];
+      if (proc.pending.erase(request -> icount) == 0)
+        return;
+
+      multimap <uint64, MemoryRequest *>::iterator first, last, it;
+      first = proc.waiting.lower_bound(request -> icount);
+      last = proc.waiting.upper_bound(request -> icount);
+      vector <MemoryRequest *> ready;
+      for (it = first; it != last; it ++)
+        ready.push_back(it -> second);
+      proc.waiting.erase(first, last);
+
+      for (uint32 i = 0; i < ready.size(); i ++) {
+        ready[i] -> issueCycle = max(ready[i] -> issueCycle,
+                                     request -> currentCycle);
+        ready[i] -> currentCycle = ready[i] -> issueCycle;
+        Issue(cpuID, ready[i]);
+      }
+    }
+
 
     // -------------------------------------------------------------------------
     // Simulate Function
@@ -125,16 +489,16 @@ class OoOTraceSimulator {
 
     void Simulate() {
 
-      bitset <128> finished;
-      bitset <128> warmUp;
-      finished.reset();
-      warmUp.reset();
+      vector <bool> finished(_numCPUs, false);
+      vector <bool> warmUp(_numCPUs, false);
+      uint32 numFinished = 0;
+      uint32 numWarmUp = 0;
 
       MemoryRequest *request;
-      static uint64 checkpoint[64];
 
-      // until all processors have finished
-      while (finished.count() < _numCPUs) {
+      // until all processors have finished, or when draining, until all the
+      // requests in the windows have completed
+      while (_draining ? !_queue.empty() : numFinished < _numCPUs) {
 	//if((_procs[0].currentIcount) % 1000 == 0)	cout << "Current cycle is " << _procs[0].currentCycle << endl;
 
         if (_queue.empty()) {
@@ -174,6 +538,7 @@ class OoOTraceSimulator {
         // else check if the oldest instruction has finished
         else {
           uint32 cpuID = request -> cpuID;
+          Complete(cpuID, request);
 
           // check if the request is out of the outstanging queue
           if (_ref.find(request) != _ref.end()) {
@@ -189,17 +554,21 @@ class OoOTraceSimulator {
 
             MemoryRequest *oldest = _procs[cpuID].outstanding.front();
             _procs[cpuID].outstanding.pop_front();
+            _procs[cpuID].dispatched --;
+            Complete(cpuID, oldest);
+            if (IsLoad(oldest)) _procs[cpuID].loads --;
+            else if (IsStore(oldest)) _procs[cpuID].stores --;
 
             // compute the current cycle of the oldest request
             oldest -> currentCycle = max(oldest -> currentCycle,
-                _procs[cpuID].currentCycle + oldest -> icount -
-                _procs[cpuID].currentIcount);
+                _procs[cpuID].currentCycle + InstCycles(oldest -> icount -
+                _procs[cpuID].currentIcount));
 
-            if (oldest -> icount > checkpoint[cpuID]) {
+            while (oldest -> icount > _procs[cpuID].progressIcount) {
               fprintf(_progress, "P%u, %llu\n",
-                  cpuID, checkpoint[cpuID]/PROGRESS_LEAP);
+                  cpuID, _procs[cpuID].progressIcount/PROGRESS_LEAP);
               fflush(_progress);
-              checkpoint[cpuID] += PROGRESS_LEAP;
+              _procs[cpuID].progressIcount += PROGRESS_LEAP;
             }
 
             // update the current cycle and icount of the processor
@@ -222,39 +591,26 @@ class OoOTraceSimulator {
             }
 
             // check if any more requests can be added to the queue
-            while (((_procs[cpuID].outstanding.back() -> icount) - 
-                  (_procs[cpuID].outstanding.front() -> icount)) < _oooWindow) {
-
-              _procs[cpuID].outstanding.back() -> issueCycle =
-                _procs[cpuID].currentCycle + 
-                _procs[cpuID].outstanding.back() -> icount - 
-                _procs[cpuID].currentIcount - _oooWindow;
+            while (WindowHasRoom(cpuID)) {
 
-              _procs[cpuID].outstanding.back() -> currentCycle = 
-                _procs[cpuID].outstanding.back() -> issueCycle;
+              request = _procs[cpuID].outstanding[_procs[cpuID].dispatched];
+              request -> issueCycle = FetchCycle(cpuID, request -> icount);
+              request -> currentCycle = request -> issueCycle;
 
               // push it to the queue and send to the simulator
-              _queue.push(_procs[cpuID].outstanding.back());
-              _simulator.ProcessMemoryRequest(_procs[cpuID].outstanding.back());
-
-              // get the next request for the processor
-              if (_synthetic)
-                request = _procs[cpuID].sreader -> NextRequest();
-              else 
-                request = _procs[cpuID].reader -> NextRequest();
-              if (request == NULL) {
-                fprintf(stderr, "No requests from processor %u\n", cpuID);
-                exit(1);
-              }
+              Dispatch(cpuID, request);
+              _procs[cpuID].dispatched ++;
 
-              // push the request to the outstanding queue
-              _procs[cpuID].outstanding.push_back(request);
+              // get the next requests for the processor
+              if (_procs[cpuID].dispatched == _procs[cpuID].outstanding.size())
+                Fetch(cpuID);
             }
 
             // check if the processor has completed run
-            if (_procs[cpuID].currentIcount > _milestones[_mIndex[cpuID]].first) {
+            if (!_draining &&
+                _procs[cpuID].currentIcount > _milestones[_mIndex[cpuID]].first) {
               bool warmUpMilestone = false;
-              if (!finished.test(cpuID)) {
+              if (!finished[cpuID]) {
 
                 switch (_milestones[_mIndex[cpuID]].second) {
 
@@ -263,19 +619,32 @@ class OoOTraceSimulator {
                     _procs[cpuID].checkpointCycle = _procs[cpuID].currentCycle;
                     warmUpMilestone = true;
                     _mIndex[cpuID] ++;
-                    warmUp.set(cpuID);
+                    if (!warmUp[cpuID]) {
+                      warmUp[cpuID] = true;
+                      numWarmUp ++;
+                    }
+                    if (_sampling) {
+                      if (numWarmUp == _numCPUs) {
+                        _simulator.GetCounters("misses", _unitMisses);
+                        _simulator.GetAllCounters(_unitCounters);
+                      }
+                      break;
+                    }
                     _simulator.EndProcWarmUp(cpuID);
-                    if (warmUp.count() == _numCPUs) {
+                    if (numWarmUp == _numCPUs) {
                       _simulator.EndWarmUp();
                     }
                     
                     break;
 
                   case END_SIMULATION:
-                    if (!finished.test(cpuID)) {
+                    if (!finished[cpuID]) {
                       _procs[cpuID].finishIcount = _procs[cpuID].currentIcount;
                       _procs[cpuID].finishCycle = _procs[cpuID].currentCycle;
-                      finished.set(cpuID);
+                      finished[cpuID] = true;
+                      numFinished ++;
+                      if (_sampling)
+                        break;
                       _simulator.EndProcSimulation(cpuID);
                       fprintf(_ipcFile, "%u %llu %llu\n", cpuID, 
                           _procs[cpuID].currentIcount - 
@@ -295,6 +664,251 @@ class OoOTraceSimulator {
       }
     }
 
+
+    // -------------------------------------------------------------------------
+    // Function to read the SimPoint regions. Each line is "interval weight",
+    // where interval is the index of the region in units of the sample unit
+    // -------------------------------------------------------------------------
+
+    void ReadSimPoints() {
+      FILE *file = fopen(_simpointFile.c_str(), "r");
+      if (file == NULL) {
+        fprintf(stderr, "SimPoint file `%s' not found\n",
+                _simpointFile.c_str());
+        exit(1);
+      }
+
+      char line[300];
+      while (fgets(line, 300, file)) {
+        uint64 interval;
+        double weight;
+        if (line[0] == '#')
+          continue;
+        if (sscanf(line, "%llu %lf", &interval, &weight) != 2)
+          continue;
+        SampleUnit unit;
+        unit.start = interval * _sampleUnit;
+        unit.weight = weight;
+        _units.push_back(unit);
+      }
+      fclose(file);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to run a sampled simulation. The first warm-up instructions
+    // and the gaps between the units are fast-forwarded on the functional
+    // path. Each unit is preceded by a detailed warm-up and followed by a
+    // drain of the requests in flight
+    // -------------------------------------------------------------------------
+
+    void SimulateSampled(uint64 warmUp, uint64 mainRun) {
+
+      if (_simpointFile != "") {
+        ReadSimPoints();
+      }
+      else {
+        for (uint64 start = warmUp + _samplePeriod - _sampleUnit;
+             start + _sampleUnit <= warmUp + mainRun;
+             start += _samplePeriod) {
+          SampleUnit unit;
+          unit.start = start;
+          unit.weight = 1;
+          _units.push_back(unit);
+        }
+      }
+
+      // statistics of the components cover the detailed simulation. their
+      // counters are replaced by their sum over the units at the end
+      _simulator.EndWarmUp();
+
+      for (uint32 u = 0; u < _units.size(); u ++) {
+        SampleUnit &unit = _units[u];
+
+        FastForward(unit.start > _sampleWarmUp ?
+                    unit.start - _sampleWarmUp : 0);
+
+        _milestones.clear();
+        _milestones.push_back(make_pair(unit.start, WARM_UP));
+        _milestones.push_back(make_pair(unit.start + _sampleUnit,
+                                        END_SIMULATION));
+        fill(_mIndex.begin(), _mIndex.end(), 0);
+
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          FillWindow(i);
+
+        Simulate();
+
+        vector <pair <string, uint64> > misses;
+        _simulator.GetCounters("misses", misses);
+        for (uint32 c = 0; c < misses.size(); c ++)
+          misses[c].second -= _unitMisses[c].second;
+        unit.misses = misses;
+
+        vector <uint64> counters;
+        _simulator.GetAllCounters(counters);
+        _sampledCounters.resize(counters.size(), 0);
+        for (uint32 c = 0; c < counters.size(); c ++)
+          _sampledCounters[c] += counters[c] - _unitCounters[c];
+
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          unit.icount.push_back(_procs[i].finishIcount -
+                                _procs[i].checkpointIcount);
+          unit.cycles.push_back(_procs[i].finishCycle -
+                                _procs[i].checkpointCycle);
+        }
+
+        _draining = true;
+        Simulate();
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          RetireDrained(i);
+        _draining = false;
+      }
+
+      if (_sampledCounters.size() > 0)
+        _simulator.SetAllCounters(_sampledCounters);
+      WriteSampleEstimates();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to retire the requests left in the window of a processor
+    // after draining. They have all completed, but the processor stopped
+    // retiring at its last milestone
+    // -------------------------------------------------------------------------
+
+    void RetireDrained(uint32 cpuID) {
+      ProcInfo &proc = _procs[cpuID];
+
+      while (proc.dispatched > 0) {
+        MemoryRequest *oldest = proc.outstanding.front();
+        assert(oldest -> finished);
+        proc.outstanding.pop_front();
+        proc.dispatched --;
+        if (IsLoad(oldest)) proc.loads --;
+        else if (IsStore(oldest)) proc.stores --;
+
+        oldest -> currentCycle = max(oldest -> currentCycle,
+            proc.currentCycle + InstCycles(oldest -> icount -
+            proc.currentIcount));
+        proc.currentIcount = oldest -> icount;
+        proc.currentCycle = oldest -> currentCycle;
+
+        // the request has left the request queue
+        _ref.erase(oldest);
+        delete oldest;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to compute the weighted mean of per-unit values and the
+    // half-width of its confidence interval. The interval is only computed
+    // for equally weighted units
+    // -------------------------------------------------------------------------
+
+    void Estimate(const vector <double> &values, double &mean, double &ci) {
+      double weights = 0;
+      mean = 0;
+      ci = 0;
+      for (uint32 u = 0; u < _units.size(); u ++) {
+        mean += _units[u].weight * values[u];
+        weights += _units[u].weight;
+      }
+      if (weights == 0)
+        return;
+      mean /= weights;
+
+      if (_simpointFile != "" || values.size() < 2)
+        return;
+      double variance = 0;
+      for (uint32 u = 0; u < values.size(); u ++)
+        variance += (values[u] - mean) * (values[u] - mean);
+      variance /= (values.size() - 1);
+      ci = SAMPLE_CONFIDENCE_Z * sqrt(variance / values.size());
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the per-unit results and the estimates to sim.sample.
+    // sim.ipc gets the weighted instructions and cycles of the units. The
+    // misses of a component are per kilo instruction of the cpus whose
+    // hierarchy contains it
+    // -------------------------------------------------------------------------
+
+    void WriteSampleEstimates() {
+
+      string sampleFileName = _simulationFolder + "/sim.sample";
+      FILE *sampleFile = fopen(sampleFileName.c_str(), "w");
+      if (sampleFile == NULL)
+        sampleFile = stdout;
+
+      fprintf(sampleFile, "# counters in SimulationLog are summed over the "
+              "units. per-cpu and prefetch statistics also cover the unit "
+              "warm-ups and drains\n");
+
+      uint32 numUnits = _units.size();
+      double weights = 0;
+      for (uint32 u = 0; u < numUnits; u ++)
+        weights += _units[u].weight;
+
+      for (uint32 u = 0; u < numUnits; u ++)
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          fprintf(sampleFile, "unit %u %llu %g %u %llu %llu\n", u,
+                  _units[u].start, _units[u].weight, i, _units[u].icount[i],
+                  _units[u].cycles[i]);
+
+      double mean, ci;
+      vector <double> values(numUnits);
+
+      for (uint32 i = 0; i < _numCPUs; i ++) {
+        double icount = 0, cycles = 0;
+        for (uint32 u = 0; u < numUnits; u ++) {
+          values[u] = (_units[u].icount[i] == 0 ? 0 :
+                       (double)_units[u].cycles[i] / _units[u].icount[i]);
+          icount += _units[u].weight * _units[u].icount[i];
+          cycles += _units[u].weight * _units[u].cycles[i];
+        }
+        Estimate(values, mean, ci);
+        fprintf(sampleFile, "cpi %u %u %.4f %.4f\n", i, numUnits, mean, ci);
+        fprintf(sampleFile, "ipc %u %u %.4f\n", i, numUnits,
+                (mean == 0 ? 0 : 1 / mean));
+
+        // instructions and cycles of the units, scaled to the number of units
+        if (weights > 0) {
+          icount *= numUnits / weights;
+          cycles *= numUnits / weights;
+        }
+        fprintf(_ipcFile, "%u %llu %llu\n", i, (uint64)(icount + 0.5),
+                (uint64)(cycles + 0.5));
+      }
+      fflush(_ipcFile);
+
+      if (numUnits > 0) {
+        for (uint32 c = 0; c < _units[0].misses.size(); c ++) {
+          vector <uint32> cpus;
+          _simulator.GetComponentCPUs(_units[0].misses[c].first, cpus);
+          if (cpus.size() == 0)
+            for (uint32 i = 0; i < _numCPUs; i ++)
+              cpus.push_back(i);
+          for (uint32 u = 0; u < numUnits; u ++) {
+            uint64 icount = 0;
+            for (uint32 i = 0; i < cpus.size(); i ++)
+              icount += _units[u].icount[cpus[i]];
+            values[u] = (icount == 0 ? 0 :
+                         1000.0 * _units[u].misses[c].second / icount);
+          }
+          Estimate(values, mean, ci);
+          fprintf(sampleFile, "mpki %s %u %.4f %.4f\n",
+                  _units[0].misses[c].first.c_str(), numUnits, mean, ci);
+        }
+      }
+
+      if (sampleFile != stdout)
+        fclose(sampleFile);
+    }
+
+
   public:
 
     // -------------------------------------------------------------------------
@@ -316,6 +930,23 @@ class OoOTraceSimulator {
       _workingSetSize = workingSetSize;
       _memGap = memGap;
 
+      _issueWidth = 1;
+      _lqSize = 0;
+      _sqSize = 0;
+      _dependencies = false;
+
+      _sampling = false;
+      _samplePeriod = 0;
+      _sampleUnit = 0;
+      _sampleWarmUp = 0;
+      _draining = false;
+
+      _functionalWarmUp = false;
+      _parallelQuantum = 0;
+
+      _sliceStart = 0;
+      _sliceEnd = 0;
+
       if (!synthetic) {
         _traceFiles.resize(_numCPUs);
       }
@@ -342,6 +973,94 @@ class OoOTraceSimulator {
     }
 
 
+    // -------------------------------------------------------------------------
+    // Function to set the core model. Load and store queue sizes of 0 are
+    // unbounded
+    // -------------------------------------------------------------------------
+
+    void SetCoreModel(uint32 issueWidth, uint32 lqSize, uint32 sqSize,
+                      bool dependencies) {
+      _issueWidth = max(issueWidth, 1U);
+      _lqSize = lqSize;
+      _sqSize = sqSize;
+      _dependencies = dependencies;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set sampled simulation. A unit of the given size is
+    // simulated in detail at the end of each period, after a detailed warm-up.
+    // With a SimPoint file, the units are the listed regions instead. A unit
+    // size of 0 disables sampling
+    // -------------------------------------------------------------------------
+
+    void SetSampling(uint64 period, uint64 unit, uint64 warmUp,
+                     string simpointFile) {
+      _sampling = (unit != 0);
+      _samplePeriod = period;
+      _sampleUnit = unit;
+      _sampleWarmUp = warmUp;
+      _simpointFile = simpointFile;
+
+      if (_sampling && _simpointFile == "" &&
+          _samplePeriod < _sampleUnit + _sampleWarmUp) {
+        fprintf(stderr, "Sample period is smaller than unit and warm-up\n");
+        exit(1);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the warm-up to run on the functional path of the memory
+    // simulator instead of in detail
+    // -------------------------------------------------------------------------
+
+    void SetFunctionalWarmUp(bool functionalWarmUp) {
+      _functionalWarmUp = functionalWarmUp;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the number of instructions per quantum of the parallel
+    // functional path. 0 keeps the functional path on a single thread
+    // -------------------------------------------------------------------------
+
+    void SetParallelQuantum(uint64 quantum) {
+      _parallelQuantum = quantum;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the spec files of the synthetic traces (see
+    // SyntheticTrace.h). With fewer files than cpus, the files are reused
+    // cyclically
+    // -------------------------------------------------------------------------
+
+    void SetSyntheticSpecs(const vector <string> &specFiles) {
+      _syntheticSpecs = specFiles;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to simulate a slice of the traces, from their start-th
+    // instruction up to their end-th one (0 for the end of the traces)
+    // -------------------------------------------------------------------------
+
+    void SetTraceSlice(uint64 start, uint64 end) {
+      _sliceStart = start;
+      _sliceEnd = end;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the number of threads decompressing chunked traces
+    // -------------------------------------------------------------------------
+
+    void SetTraceThreads(uint32 threads) {
+      TraceThreadPool().Start(threads);
+    }
+
+
     // -------------------------------------------------------------------------
     // Function to start the simulation
     // -------------------------------------------------------------------------
@@ -356,6 +1075,15 @@ class OoOTraceSimulator {
       if (!_synthetic) {
         for (uint32 i = 0; i < _numCPUs; i ++)
           _procs[i].reader = new TraceReader(_traceFiles[i], i, true);
+        if (_sliceStart > 1 || _sliceEnd != 0) {
+          for (uint32 i = 0; i < _numCPUs; i ++)
+            _procs[i].reader -> Slice(_sliceStart, _sliceEnd);
+        }
+      }
+      else if (!_syntheticSpecs.empty()) {
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          _procs[i].sreader = new SyntheticTrace(
+              _syntheticSpecs[i % _syntheticSpecs.size()], _memGap, i);
       }
       else {
         for (uint32 i = 0; i < _numCPUs; i ++)
@@ -366,52 +1094,25 @@ class OoOTraceSimulator {
       // for each processor, fill its outstanding queue
       for (uint32 i = 0; i < _numCPUs; i ++) {
 
-        MemoryRequest *request;
-
-        // get the fist request from the reader
-        if (_synthetic)
-          request = _procs[i].sreader -> NextRequest();
-        else 
-          request = _procs[i].reader -> NextRequest();
-        if (request == NULL) {
-          fprintf(stderr, "No requests from processor %u\n", i);
-          exit(1);
-        }
+        // get the first requests from the reader
+        _procs[i].outstanding.reserve(_oooWindow + FETCH_BATCH + 1);
+        _procs[i].dispatched = 0;
+        Fetch(i);
 
         // set the current cycle and icount of the processor
         _procs[i].currentIcount = 0;
         _procs[i].currentCycle = 0;
-
-        request -> issueCycle = 0;
-        request -> currentCycle = 0;
-
-        // push the request to the outstanding queue
-        _procs[i].outstanding.push_back(request);
-
-        // while there is room in the out-of-order window
-        while (((_procs[i].outstanding.back() -> icount) - 
-            (_procs[i].outstanding.front() -> icount)) < _oooWindow) {
-
-          _queue.push(_procs[i].outstanding.back());
-          _simulator.ProcessMemoryRequest(_procs[i].outstanding.back());
-
-	// **** Are we completing the simulation here?
-
-
-
-          // get the next request 
-          if (_synthetic)
-            request = _procs[i].sreader -> NextRequest();
-          else 
-            request = _procs[i].reader -> NextRequest();
-          if (request == NULL) {
-            assert(false && "No requests from processor");
-          }
-
-          request -> issueCycle = request -> icount;
-          request -> currentCycle = request -> issueCycle;
-          _procs[i].outstanding.push_back(request);
-        }
+        _procs[i].loads = 0;
+        _procs[i].stores = 0;
+        _procs[i].dependentRequests = 0;
+        _procs[i].lqStalls = 0;
+        _procs[i].sqStalls = 0;
+        _procs[i].progressIcount = 0;
+
+        // in sampling mode, the windows are filled at each unit. with a
+        // functional warm-up, they are filled after it
+        if (!_sampling && !_functionalWarmUp)
+          FillWindow(i);
       }
     }
 
@@ -426,16 +1127,50 @@ class OoOTraceSimulator {
       _nextHeartBeatCycle = _hbCount;
       uint64 current;
 
-      current = warmUp;
-      _milestones.push_back(make_pair(current, WARM_UP));
+      if (_sampling) {
+        SimulateSampled(warmUp, mainRun);
+      }
+      else if (_functionalWarmUp) {
+        FastForward(warmUp);
+        for (uint32 i = 0; i < _numCPUs; i ++) {
+          _procs[i].checkpointIcount = _procs[i].currentIcount;
+          _procs[i].checkpointCycle = _procs[i].currentCycle;
+          _simulator.EndProcWarmUp(i);
+        }
+        _simulator.EndWarmUp();
+
+        current = warmUp + mainRun;
+        _milestones.push_back(make_pair(current, END_SIMULATION));
 
-      current = warmUp + mainRun;
-      _milestones.push_back(make_pair(current, END_SIMULATION));
+        for (uint32 i = 0; i < _numCPUs; i ++)
+          FillWindow(i);
+        Simulate();
+      }
+      else {
+        current = warmUp;
+        _milestones.push_back(make_pair(current, WARM_UP));
+
+        current = warmUp + mainRun;
+        _milestones.push_back(make_pair(current, END_SIMULATION));
 
-      Simulate();
+        Simulate();
+      }
       
       _simulator.EndSimulation();
 
+      // core model statistics
+      if (_issueWidth > 1 || _lqSize != 0 || _sqSize != 0 || _dependencies) {
+        string coreFileName = _simulationFolder + "/sim.core";
+        FILE *coreFile = fopen(coreFileName.c_str(), "w");
+        if (coreFile != NULL) {
+          for (uint32 i = 0; i < _numCPUs; i ++)
+            fprintf(coreFile, "%u %llu %llu %llu\n", i,
+                    _procs[i].dependentRequests, _procs[i].lqStalls,
+                    _procs[i].sqStalls);
+          fclose(coreFile);
+        }
+      }
+
       fclose(_ipcFile);
       fclose(_progress);
     }
@@ -0,0 +1,275 @@
+// -----------------------------------------------------------------------------
+// File: PrefetchFeedback.h
+// Description:
+//    Defines the feedback controller that throttles the prefetchers, based
+//    on feedback directed prefetching. A prefetcher subscribes to the
+//    controller and reports its prefetches and the demands it sees. The
+//    last-level cache reports the blocks evicted by prefetches and its
+//    demand misses, and the MSHRs report the prefetches they drop, which
+//    never fill and are not counted as used. At the end of each interval
+//    (a heart beat), the controller computes for each prefetcher
+//
+//    - accuracy: prefetched blocks used by a demand / prefetches
+//    - lateness: blocks used before their prefetch returned / used
+//    - pollution: demand misses to blocks evicted by a prefetch of the
+//      prefetcher / demand misses. The evicted blocks are kept in a small
+//      bloom filter (one hash), cleared when a miss hits it and at the end
+//      of the interval
+//
+//    and moves its aggressiveness level up or down. The counts are smoothed
+//    over the intervals (each interval counts half).
+// -----------------------------------------------------------------------------
+
+#ifndef __PREFETCH_FEEDBACK_H__
+#define __PREFETCH_FEEDBACK_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "GenericTable.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+
+using namespace std;
+
+// aggressiveness levels. The top level is the configuration of the
+// prefetcher, each level below halves its degree and distance
+#define FEEDBACK_LEVELS 5
+
+// outcome of a demand to a block
+#define FEEDBACK_NONE 0
+#define FEEDBACK_USEFUL 1
+#define FEEDBACK_LATE 2
+
+
+// -----------------------------------------------------------------------------
+// Class: prefetch_feedback_t
+// Description:
+//    Collects the prefetch feedback of the subscribed prefetchers and sets
+//    their aggressiveness levels.
+// -----------------------------------------------------------------------------
+
+class prefetch_feedback_t {
+
+  public:
+
+    struct thresholds_t {
+      double accuracyHigh;
+      double accuracyLow;
+      double lateness;
+      double pollution;
+    };
+
+  protected:
+
+    struct subscriber_t {
+      const void *owner;
+      thresholds_t thresholds;
+      uint32 level;
+
+      // prefetched blocks, and the cycle their prefetch returns (-1 until
+      // it returns)
+      generic_table_t <addr_t, cycles_t> monitor;
+
+      // blocks evicted by the prefetches
+      vector <bool> filter;
+      uint32 filterShift;
+
+      // counts of the interval, and smoothed counts
+      uint64 issued, useful, late, polluting, misses;
+      uint64 sIssued, sUseful, sLate, sPolluting, sMisses;
+    };
+
+    vector <subscriber_t *> _subscribers;
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the filter bit of a block
+    // -------------------------------------------------------------------------
+
+    uint32 FilterBit(subscriber_t *s, addr_t block) {
+      return (uint32)((block * 0x9E3779B97F4A7C15ULL) >> s -> filterShift);
+    }
+
+
+  public:
+
+    ~prefetch_feedback_t() {
+      for (uint32 i = 0; i < _subscribers.size(); i ++)
+        delete _subscribers[i];
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to subscribe a prefetcher. Returns its id. The monitor keeps
+    // the last monitorSize prefetched blocks, the filter has at least
+    // filterSize bits
+    // -------------------------------------------------------------------------
+
+    uint32 Subscribe(const void *owner, uint32 monitorSize, uint32 filterSize,
+                     thresholds_t thresholds) {
+      subscriber_t *s = new subscriber_t;
+      s -> owner = owner;
+      s -> thresholds = thresholds;
+      s -> level = FEEDBACK_LEVELS - 1;
+      s -> monitor.SetTableParameters(monitorSize, "fifo");
+
+      uint32 bits = 1;
+      while ((1U << bits) < filterSize)
+        bits ++;
+      s -> filter.assign(1U << bits, false);
+      s -> filterShift = 64 - bits;
+
+      s -> issued = s -> useful = s -> late = s -> polluting = s -> misses = 0;
+      s -> sIssued = s -> sUseful = s -> sLate = s -> sPolluting = 0;
+      s -> sMisses = 0;
+
+      _subscribers.push_back(s);
+      return _subscribers.size() - 1;
+    }
+
+    uint32 Level(uint32 id) { return _subscribers[id] -> level; }
+
+
+    // -------------------------------------------------------------------------
+    // Functions called by the prefetchers: a prefetch is issued, a prefetch
+    // returns, and a demand is seen. Demand returns the outcome for the block
+    // -------------------------------------------------------------------------
+
+    void Issued(uint32 id, addr_t block) {
+      subscriber_t *s = _subscribers[id];
+      s -> issued ++;
+      if (s -> monitor.lookup(block))
+        s -> monitor[block] = (cycles_t)(-1);
+      else
+        s -> monitor.insert(block, (cycles_t)(-1));
+    }
+
+    void Filled(uint32 id, addr_t block, cycles_t cycle) {
+      subscriber_t *s = _subscribers[id];
+      if (s -> monitor.lookup(block))
+        s -> monitor[block] = cycle;
+    }
+
+    uint32 Demand(uint32 id, addr_t block, cycles_t cycle) {
+      subscriber_t *s = _subscribers[id];
+      if (!s -> monitor.lookup(block))
+        return FEEDBACK_NONE;
+      cycles_t ready = s -> monitor[block];
+      s -> monitor.invalidate(block);
+      s -> useful ++;
+      if (ready <= cycle)
+        return FEEDBACK_USEFUL;
+      s -> late ++;
+      return FEEDBACK_LATE;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called by the MSHRs when a prefetch of owner is dropped
+    // before it fills. The block is no longer monitored, so a later demand
+    // to it is not counted as useful or late
+    // -------------------------------------------------------------------------
+
+    void Dropped(const void *owner, addr_t block) {
+      for (uint32 i = 0; i < _subscribers.size(); i ++) {
+        subscriber_t *s = _subscribers[i];
+        if (s -> owner == owner && s -> monitor.lookup(block) &&
+            s -> monitor[block] == (cycles_t)(-1))
+          s -> monitor.invalidate(block);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Functions called by the last-level cache: a prefetch of owner evicts
+    // a block, and a demand misses
+    // -------------------------------------------------------------------------
+
+    void Evicted(const void *owner, addr_t block) {
+      for (uint32 i = 0; i < _subscribers.size(); i ++) {
+        subscriber_t *s = _subscribers[i];
+        if (s -> owner == owner)
+          s -> filter[FilterBit(s, block)] = true;
+      }
+    }
+
+    void DemandMiss(addr_t block) {
+      for (uint32 i = 0; i < _subscribers.size(); i ++) {
+        subscriber_t *s = _subscribers[i];
+        s -> misses ++;
+        uint32 bit = FilterBit(s, block);
+        if (s -> filter[bit]) {
+          s -> filter[bit] = false;
+          s -> polluting ++;
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to end the interval of a prefetcher. Returns its new level
+    // -------------------------------------------------------------------------
+
+    uint32 Interval(uint32 id) {
+      subscriber_t *s = _subscribers[id];
+
+      s -> sIssued = (s -> sIssued + s -> issued) / 2;
+      s -> sUseful = (s -> sUseful + s -> useful) / 2;
+      s -> sLate = (s -> sLate + s -> late) / 2;
+      s -> sPolluting = (s -> sPolluting + s -> polluting) / 2;
+      s -> sMisses = (s -> sMisses + s -> misses) / 2;
+      s -> issued = s -> useful = s -> late = s -> polluting = s -> misses = 0;
+      s -> filter.assign(s -> filter.size(), false);
+
+      // nothing to judge the prefetcher on
+      if (s -> sIssued == 0)
+        return s -> level;
+
+      double accuracy = (double)s -> sUseful / s -> sIssued;
+      bool late = (s -> sUseful != 0 &&
+                   (double)s -> sLate / s -> sUseful > s -> thresholds.lateness);
+      bool polluting = (s -> sMisses != 0 &&
+                        (double)s -> sPolluting / s -> sMisses >
+                        s -> thresholds.pollution);
+
+      // late prefetches of an accurate prefetcher need more distance, and
+      // pollution or late prefetches of an inaccurate one need less
+      int32 change = 0;
+      if (accuracy >= s -> thresholds.accuracyHigh) {
+        if (late) change = 1;
+        else if (polluting) change = -1;
+      }
+      else if (accuracy >= s -> thresholds.accuracyLow) {
+        if (polluting) change = -1;
+        else if (late) change = 1;
+      }
+      else {
+        if (late || polluting) change = -1;
+      }
+
+      if (change > 0 && s -> level < FEEDBACK_LEVELS - 1)
+        s -> level ++;
+      else if (change < 0 && s -> level > 0)
+        s -> level --;
+      return s -> level;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// The controller shared by all the prefetchers and caches
+// -----------------------------------------------------------------------------
+
+inline prefetch_feedback_t &PrefetchFeedback() {
+  static prefetch_feedback_t feedback;
+  return feedback;
+}
+
+#endif // __PREFETCH_FEEDBACK_H__
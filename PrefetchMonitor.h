@@ -0,0 +1,314 @@
+// -----------------------------------------------------------------------------
+// File: PrefetchMonitor.h
+// Description:
+//    Defines the prefetch metadata kept with each cache line, and the monitor
+//    that a cache uses to collect per-prefetcher statistics from it. A line
+//    filled by a prefetch records the prefetcher that issued it, the id of
+//    the prefetch within the prefetcher, and the cycles at which the prefetch
+//    was issued, filled and first used. For each prefetcher, the monitor
+//    counts
+//
+//    - fills: lines filled by its prefetches
+//    - useful: prefetched lines used by a demand
+//    - late: demands that missed while the prefetch was in flight, and were
+//      served by its fill
+//    - unused: prefetched lines evicted before any use
+//    - polluting: demand misses to lines evicted by its prefetches. The
+//      evicted lines are kept in a small FIFO table
+//    - fill cycles: issue to fill, and use cycles: fill to first use
+//
+//    With a trace, one in every sampling prefetched lines records its
+//    lifetime when it is evicted. Traced lines still present at the end of
+//    the simulation are recorded with an evict cycle of 0.
+// -----------------------------------------------------------------------------
+
+#ifndef __PREFETCH_MONITOR_H__
+#define __PREFETCH_MONITOR_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "MemoryComponent.h"
+#include "MemoryRequest.h"
+#include "GenericTable.h"
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Structure: prefetch_line_t
+// Description:
+//    Prefetch metadata of a cache line. source is 0 if the line was not
+//    filled by a prefetch, otherwise the prefetcher index in the monitor
+//    plus one.
+// -----------------------------------------------------------------------------
+
+struct prefetch_line_t {
+  uint16 source;
+  bool used;
+  bool traced;
+  uint32 prefetcherID;
+  cycles_t issueCycle;
+  cycles_t fillCycle;
+  cycles_t useCycle;
+
+  prefetch_line_t() {
+    source = 0;
+    used = false;
+    traced = false;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: prefetch_monitor_t
+// Description:
+//    Collects the statistics of the prefetches filled into a cache.
+// -----------------------------------------------------------------------------
+
+class prefetch_monitor_t {
+
+  protected:
+
+    struct source_t {
+      const void *prefetcher;
+      string name;
+      uint64 fills, useful, late, unused, polluting;
+      uint64 fillCycles, useCycles;
+    };
+
+    vector <source_t> _sources;
+
+    // lines evicted by prefetches, and the source of the prefetch
+    generic_table_t <addr_t, uint16> _victims;
+    bool _victimsEnabled;
+
+    // sampled lifetime trace
+    FILE *_trace;
+    uint32 _sampling;
+    uint64 _sampled;
+
+
+    // -------------------------------------------------------------------------
+    // Function to get the source of a prefetch request, adding it if needed
+    // -------------------------------------------------------------------------
+
+    uint16 Source(MemoryRequest *request) {
+      const void *prefetcher = request -> prefetcher;
+      for (uint32 i = 0; i < _sources.size(); i ++)
+        if (_sources[i].prefetcher == prefetcher)
+          return i + 1;
+
+      source_t source;
+      source.prefetcher = prefetcher;
+      source.name = (prefetcher != NULL ?
+                     ((MemoryComponent *)prefetcher) -> Name() : "unknown");
+      source.fills = source.useful = source.late = 0;
+      source.unused = source.polluting = 0;
+      source.fillCycles = source.useCycles = 0;
+      _sources.push_back(source);
+      return _sources.size();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to record the first use of a prefetched line
+    // -------------------------------------------------------------------------
+
+    void FirstUse(prefetch_line_t &line, cycles_t cycle) {
+      source_t &source = _sources[line.source - 1];
+      line.used = true;
+      line.useCycle = cycle;
+      source.useful ++;
+      source.useCycles += (cycle > line.fillCycle ? cycle - line.fillCycle : 0);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the lifetime of a traced line
+    // -------------------------------------------------------------------------
+
+    void Trace(prefetch_line_t &line, addr_t block, cycles_t evictCycle) {
+      fprintf(_trace, "%llu,%s,%u,%llu,%llu,%llu,%llu\n", block,
+              _sources[line.source - 1].name.c_str(), line.prefetcherID,
+              line.issueCycle, line.fillCycle,
+              (line.used ? line.useCycle : 0), evictCycle);
+    }
+
+
+  public:
+
+    prefetch_monitor_t() {
+      _victimsEnabled = false;
+      _trace = NULL;
+      _sampling = 0;
+      _sampled = 0;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to set the size of the table of lines evicted by prefetches
+    // (0 to not count polluting prefetches)
+    // -------------------------------------------------------------------------
+
+    void SetVictims(uint32 size) {
+      _victimsEnabled = (size != 0);
+      if (_victimsEnabled)
+        _victims.SetTableParameters(size, "fifo");
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to start tracing one in every sampling prefetched lines to a
+    // file (NULL or 0 to not trace)
+    // -------------------------------------------------------------------------
+
+    void SetTrace(FILE *trace, uint32 sampling) {
+      _trace = trace;
+      _sampling = sampling;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called when a request fills a line
+    // -------------------------------------------------------------------------
+
+    void Fill(prefetch_line_t &line, MemoryRequest *request) {
+      line = prefetch_line_t();
+      if (request -> type != MemoryRequest::PREFETCH)
+        return;
+
+      line.source = Source(request);
+      line.prefetcherID = request -> prefetcherID;
+      line.issueCycle = request -> issueCycle;
+      line.fillCycle = request -> currentCycle;
+      if (_trace != NULL && _sampling != 0)
+        line.traced = ((_sampled ++) % _sampling == 0);
+
+      source_t &source = _sources[line.source - 1];
+      source.fills ++;
+      source.fillCycles += line.fillCycle - line.issueCycle;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called when a demand hits a line
+    // -------------------------------------------------------------------------
+
+    void Use(prefetch_line_t &line, cycles_t cycle) {
+      if (line.source != 0 && !line.used)
+        FirstUse(line, cycle);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called when a demand that missed returns and finds the line
+    // present. If the line was prefetched and not used yet, the demand
+    // waited for the prefetch
+    // -------------------------------------------------------------------------
+
+    void Merged(prefetch_line_t &line, cycles_t cycle) {
+      if (line.source == 0 || line.used)
+        return;
+      FirstUse(line, cycle);
+      _sources[line.source - 1].late ++;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called when a line is evicted by a fill
+    // -------------------------------------------------------------------------
+
+    void Evict(prefetch_line_t &line, addr_t block, MemoryRequest *fill) {
+
+      if (line.source != 0 && !line.used)
+        _sources[line.source - 1].unused ++;
+
+      if (line.traced)
+        Trace(line, block, fill -> currentCycle);
+
+      if (_victimsEnabled && fill -> type == MemoryRequest::PREFETCH) {
+        uint16 source = Source(fill);
+        if (_victims.lookup(block))
+          _victims[block] = source;
+        else
+          _victims.insert(block, source);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called for each line present at the end of the simulation
+    // -------------------------------------------------------------------------
+
+    void Resident(prefetch_line_t &line, addr_t block) {
+      if (line.traced)
+        Trace(line, block, 0);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function called when a demand misses
+    // -------------------------------------------------------------------------
+
+    void DemandMiss(addr_t block) {
+      if (!_victimsEnabled || !_victims.lookup(block))
+        return;
+      _sources[_victims[block] - 1].polluting ++;
+      _victims.invalidate(block);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to reset the statistics (at the end of the warm up)
+    // -------------------------------------------------------------------------
+
+    void Reset() {
+      for (uint32 i = 0; i < _sources.size(); i ++) {
+        source_t &source = _sources[i];
+        source.fills = source.useful = source.late = 0;
+        source.unused = source.polluting = 0;
+        source.fillCycles = source.useCycles = 0;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the statistics of each prefetcher into the
+    // simulation log of a component
+    // -------------------------------------------------------------------------
+
+    void Dump(FILE *log, string component) {
+      for (uint32 i = 0; i < _sources.size(); i ++) {
+        source_t &source = _sources[i];
+        const char *cname = component.c_str();
+        const char *pname = source.name.c_str();
+        fprintf(log, "%s:prefetch_fills-%s = %llu\n", cname, pname,
+                source.fills);
+        fprintf(log, "%s:prefetch_useful-%s = %llu\n", cname, pname,
+                source.useful);
+        fprintf(log, "%s:prefetch_late-%s = %llu\n", cname, pname,
+                source.late);
+        fprintf(log, "%s:prefetch_unused-%s = %llu\n", cname, pname,
+                source.unused);
+        fprintf(log, "%s:prefetch_polluting-%s = %llu\n", cname, pname,
+                source.polluting);
+        fprintf(log, "%s:prefetch_fill_cycles-%s = %llu\n", cname, pname,
+                source.fillCycles);
+        fprintf(log, "%s:prefetch_use_cycles-%s = %llu\n", cname, pname,
+                source.useCycles);
+      }
+    }
+};
+
+#endif // __PREFETCH_MONITOR_H__
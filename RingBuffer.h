@@ -0,0 +1,131 @@
+// -----------------------------------------------------------------------------
+// File: RingBuffer.h
+// Description:
+//    This file defines a ring buffer (FIFO with indexed access) over a
+//    contiguous array. It doubles its capacity when it is full.
+// -----------------------------------------------------------------------------
+
+#ifndef __RING_BUFFER_H__
+#define __RING_BUFFER_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <cassert>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Class: ring_buffer_t
+// Description:
+//    Entries are pushed at the back and popped from the front. Index 0 is
+//    the front.
+// -----------------------------------------------------------------------------
+
+template <class T>
+class ring_buffer_t {
+
+protected:
+
+  // ---------------------------------------------------------------------------
+  // Private members
+  // ---------------------------------------------------------------------------
+
+  vector <T> _entries;
+  uint32 _head;
+  uint32 _count;
+
+
+  // ---------------------------------------------------------------------------
+  // Function to double the capacity, moving the entries to the beginning
+  // ---------------------------------------------------------------------------
+
+  void grow() {
+    vector <T> entries(_entries.size() * 2);
+    for (uint32 i = 0; i < _count; i ++)
+      entries[i] = (*this)[i];
+    _entries.swap(entries);
+    _head = 0;
+  }
+
+
+public:
+
+  // ---------------------------------------------------------------------------
+  // Constructor
+  // ---------------------------------------------------------------------------
+
+  ring_buffer_t(uint32 capacity = 16) {
+    _entries.resize(capacity > 0 ? capacity : 1);
+    _head = 0;
+    _count = 0;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to make room for at least the given number of entries
+  // ---------------------------------------------------------------------------
+
+  void reserve(uint32 capacity) {
+    while (_entries.size() < capacity)
+      grow();
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Accessors
+  // ---------------------------------------------------------------------------
+
+  bool empty() { return (_count == 0); }
+  uint32 size() { return _count; }
+  uint32 capacity() { return _entries.size(); }
+
+  T & operator[] (uint32 index) {
+    assert(index < _count || (index == _count && _count < _entries.size()));
+    uint32 slot = _head + index;
+    if (slot >= _entries.size())
+      slot -= _entries.size();
+    return _entries[slot];
+  }
+
+  T & front() {
+    assert(_count > 0);
+    return _entries[_head];
+  }
+
+  T & back() {
+    assert(_count > 0);
+    return (*this)[_count - 1];
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Insert at the back and remove from the front
+  // ---------------------------------------------------------------------------
+
+  void push_back(const T &value) {
+    if (_count == _entries.size())
+      grow();
+    (*this)[_count] = value;
+    _count ++;
+  }
+
+  void pop_front() {
+    assert(_count > 0);
+    _head ++;
+    if (_head == _entries.size())
+      _head = 0;
+    _count --;
+  }
+};
+
+#endif // __RING_BUFFER_H__
@@ -26,6 +26,15 @@ from plotlib import PlotLib
 
 WORKLOAD_FOLDER = "Simulator/Workloads/"
 
+# ------------------------------------------------------------------------------
+# Function to divide two statistics, 0 if the denominator is 0
+# ------------------------------------------------------------------------------
+
+def ratio(numerator, denominator):
+    if denominator == 0:
+        return 0
+    return numerator / denominator
+
 # ------------------------------------------------------------------------------
 # Function to parse results file
 # ------------------------------------------------------------------------------
@@ -62,27 +71,55 @@ def parse_simulation_log(bench_folder):
         print bench_folder
         exit
     
-    data["llc"]["ins_prefetches"] = data["llc"]["used_prefetches"] + data["llc"]["unused_prefetches"] + 1
+    # --------------------------------------------------------------------------
+    # Prefetch monitors of the LLC variants with prefetch states
+    # --------------------------------------------------------------------------
+
+    if "used_prefetches" in data["llc"]:
+        data["llc"]["ins_prefetches"] = data["llc"]["used_prefetches"] + data["llc"]["unused_prefetches"] + 1
     
-    data["llc"]["used_prefetch_frac"] = (data["llc"]["used_prefetches"] * 100) / data["llc"]["ins_prefetches"]
-    data["llc"]["unused_prefetch_frac"] = (data["llc"]["unused_prefetches"] * 100) / data["llc"]["ins_prefetches"]
-
-    if "predicted_accurate" in data["llc"]:
-        data["llc"]["predicted_accurate_frac"] = (data["llc"]["predicted_accurate"] * 100) / data["llc"]["ins_prefetches"]
-        data["llc"]["accurate_predicted_inaccurate_frac"] = (data["llc"]["accurate_predicted_inaccurate"] * 100) / data["llc"]["ins_prefetches"]
-        data["llc"]["inaccurate_predicted_accurate_frac"] = (data["llc"]["accurate_predicted_inaccurate"] * 100) / data["llc"]["ins_prefetches"]
-        data["llc"]["incorrect_frac"] = ((data["llc"]["accurate_predicted_inaccurate"] + data["llc"]["inaccurate_predicted_accurate"]) * 100) / data["llc"]["ins_prefetches"]
+        data["llc"]["used_prefetch_frac"] = (data["llc"]["used_prefetches"] * 100) / data["llc"]["ins_prefetches"]
+        data["llc"]["unused_prefetch_frac"] = (data["llc"]["unused_prefetches"] * 100) / data["llc"]["ins_prefetches"]
+
+        if "predicted_accurate" in data["llc"]:
+            data["llc"]["predicted_accurate_frac"] = (data["llc"]["predicted_accurate"] * 100) / data["llc"]["ins_prefetches"]
+            data["llc"]["accurate_predicted_inaccurate_frac"] = (data["llc"]["accurate_predicted_inaccurate"] * 100) / data["llc"]["ins_prefetches"]
+            data["llc"]["inaccurate_predicted_accurate_frac"] = (data["llc"]["accurate_predicted_inaccurate"] * 100) / data["llc"]["ins_prefetches"]
+            data["llc"]["incorrect_frac"] = ((data["llc"]["accurate_predicted_inaccurate"] + data["llc"]["inaccurate_predicted_accurate"]) * 100) / data["llc"]["ins_prefetches"]
     
-    data["llc"]["used_prefetches"] += 1
-    data["llc"]["reused_prefetch_frac"] = (data["llc"]["reused_prefetches"] * 100) / data["llc"]["used_prefetches"]
-    data["llc"]["unreused_prefetch_frac"] = (data["llc"]["unreused_prefetches"] * 100) / data["llc"]["used_prefetches"]
+        data["llc"]["used_prefetches"] += 1
+        data["llc"]["reused_prefetch_frac"] = (data["llc"]["reused_prefetches"] * 100) / data["llc"]["used_prefetches"]
+        data["llc"]["unreused_prefetch_frac"] = (data["llc"]["unreused_prefetches"] * 100) / data["llc"]["used_prefetches"]
 
-    data["llc"]["prefetch_use_cycle"] = (data["llc"]["prefetch_use_cycle"]) /data["llc"]["used_prefetches"]
-    data["llc"]["prefetch_use_miss"] = (data["llc"]["prefetch_use_miss"]) /data["llc"]["used_prefetches"]
+        data["llc"]["prefetch_use_cycle"] = (data["llc"]["prefetch_use_cycle"]) /data["llc"]["used_prefetches"]
+        data["llc"]["prefetch_use_miss"] = (data["llc"]["prefetch_use_miss"]) /data["llc"]["used_prefetches"]
     
     
-    data["llc"]["prefetch_lifetime_cycle"] = (data["llc"]["prefetch_lifetime_cycle"]) /data["llc"]["ins_prefetches"]
-    data["llc"]["prefetch_lifetime_miss"] = (data["llc"]["prefetch_lifetime_miss"]) /data["llc"]["ins_prefetches"]
+        data["llc"]["prefetch_lifetime_cycle"] = (data["llc"]["prefetch_lifetime_cycle"]) /data["llc"]["ins_prefetches"]
+        data["llc"]["prefetch_lifetime_miss"] = (data["llc"]["prefetch_lifetime_miss"]) /data["llc"]["ins_prefetches"]
+
+
+    # --------------------------------------------------------------------------
+    # Per-prefetcher statistics of the cache prefetch monitors
+    # --------------------------------------------------------------------------
+
+    for component in data.values():
+        for field in component.keys():
+            if not field.startswith("prefetch_fills-"):
+                continue
+            prefetcher = field[len("prefetch_fills-"):]
+            fills = component[field]
+            useful = component["prefetch_useful-" + prefetcher]
+            component["prefetch_accuracy-" + prefetcher] = ratio(useful * 100, fills)
+            component["prefetch_late_frac-" + prefetcher] = ratio(component["prefetch_late-" + prefetcher] * 100, useful)
+            component["prefetch_unused_frac-" + prefetcher] = ratio(component["prefetch_unused-" + prefetcher] * 100, fills)
+            if "misses" in component:
+                component["prefetch_pollution_frac-" + prefetcher] = ratio(component["prefetch_polluting-" + prefetcher] * 100, component["misses"])
+            component["prefetch_fill_latency-" + prefetcher] = ratio(component["prefetch_fill_cycles-" + prefetcher], fills)
+            component["prefetch_use_distance-" + prefetcher] = ratio(component["prefetch_use_cycles-" + prefetcher], useful)
+
+    if "mc" in data and "write_activations" in data["mc"]:
+        data["mc"]["writes_per_activation"] = ratio(data["mc"]["writes"], data["mc"]["write_activations"])
 
 
     fin = open(bench_folder + "/sim.ipc", "r")
@@ -100,6 +137,10 @@ def parse_simulation_log(bench_folder):
    
     fin.close()
 
+    if "mc" in data and "energy_total" in data["mc"]:
+        insts = sum(data["sim"]["insts"].values())
+        data["mc"]["energy_per_kinst"] = data["mc"]["energy_total"] * 1000 / insts
+
     return data
 
 
@@ -179,6 +220,12 @@ def get_metric(name):
         return ("llc:predicted_accurate_frac", None)
     elif name == "incorrect_pred":
         return ("llc:incorrect_frac", None)
+    elif name == "wb_row_locality":
+        return ("mc:writes_per_activation", None)
+    elif name == "mem_p99":
+        return ("mc:read_latency_p99-0", None)
+    elif name == "mem_epki":
+        return ("mc:energy_per_kinst", None)
     
     print "Error: Undefined metric name"
     quit()
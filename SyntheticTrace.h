@@ -1,67 +1,697 @@
+// -----------------------------------------------------------------------------
+// File: SyntheticTrace.h
+// Description:
+//    Defines a synthetic trace generator. A trace is a cyclic sequence of
+//    phases. Each phase runs for a number of instructions and draws its
+//    requests from a weighted set of regions, each of which generates
+//    addresses with an access pattern:
+//
+//      sequential  cyclic walk over the blocks of the region
+//      stride      cyclic walk with a stride in bytes
+//      random      uniform over the blocks of the region
+//      zipf        Zipfian over the blocks (hot set), scattered over the
+//                  region
+//      chase       pointer chase over a random cycle through all the blocks.
+//                  Each request depends on the previous one of the region
+//      stream      sequential walk that re-touches a recently streamed
+//                  block with a given probability
+//
+//    The generator is described by a spec file. Each line is a keyword
+//    followed by its arguments. '#' starts a comment.
+//
+//      seed <n>                      seed of the random numbers (per cpu,
+//                                    the seed is mixed with the cpu id)
+//      block-size <bytes>            block size of the patterns (64)
+//      gap <instructions>            instructions between two requests, for
+//                                    the current phase (or all phases when
+//                                    given before the first one)
+//      phase <instructions>          start a new phase. 0 never ends
+//      region <pattern> <size-kb> [<option> <value>]...
+//                                    add a region to the current phase
+//
+//    Region options:
+//      weight <n>       relative share of the requests of the phase (1).
+//                       Must not be 0
+//      write <f>        fraction of writes (0)
+//      offset <kb>      offset of the region. By default, regions are laid
+//                       out one after the other, so a region can be shared
+//                       by phases by giving it the same offset
+//      stride <bytes>   stride (2 blocks)
+//      alpha <f>        Zipf exponent (0.99)
+//      reuse <f>        stream: probability to re-touch a block (0.5)
+//      window <blocks>  stream: how far back the re-touched block is (64)
+//
+//    Regions without a phase form a single phase that never ends.
+// -----------------------------------------------------------------------------
+
 #ifndef __SYNTHETIC_TRACE_H__
 #define __SYNTHETIC_TRACE_H__
 
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
 #include "Types.h"
 #include "MemoryRequest.h"
 
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Class: xorshift_rng_t
+// Description:
+//    xorshift64* random numbers. The sequence only depends on the seed, so
+//    synthetic traces are the same across machines and libraries.
+// -----------------------------------------------------------------------------
+
+class xorshift_rng_t {
+
+protected:
+
+  uint64 _state;
+
+public:
+
+  xorshift_rng_t(uint64 seed = 1) {
+    this -> seed(seed);
+  }
+
+  void seed(uint64 seed) {
+    // splitmix the seed so that close seeds give unrelated sequences
+    uint64 z = seed + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    _state = z ^ (z >> 31);
+    if (_state == 0) _state = 1;
+  }
+
+  uint64 next() {
+    _state ^= _state >> 12;
+    _state ^= _state << 25;
+    _state ^= _state >> 27;
+    return _state * 0x2545f4914f6cdd1dULL;
+  }
+
+  // uniform in [0, n)
+  uint64 below(uint64 n) {
+    return next() % n;
+  }
+
+  // uniform in [0, 1)
+  double uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: zipf_sampler_t
+// Description:
+//    Draws ranks in [1, n] with P(k) proportional to 1/k^alpha, using
+//    rejection-inversion (Hormann and Derflinger). Constant time and space,
+//    so large hot sets do not need a table.
+// -----------------------------------------------------------------------------
+
+class zipf_sampler_t {
+
+protected:
+
+  uint64 _n;
+  double _alpha;
+  double _hX1;
+  double _hN;
+  double _s;
+
+  static double helper1(double x) {
+    if (fabs(x) > 1e-8) return log1p(x) / x;
+    return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+  }
+
+  static double helper2(double x) {
+    if (fabs(x) > 1e-8) return expm1(x) / x;
+    return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+  }
+
+  double h(double x) {
+    return exp(-_alpha * log(x));
+  }
+
+  double hIntegral(double x) {
+    double logX = log(x);
+    return helper2((1 - _alpha) * logX) * logX;
+  }
+
+  double hIntegralInverse(double x) {
+    double t = x * (1 - _alpha);
+    if (t < -1) t = -1;
+    return exp(helper1(t) * x);
+  }
+
+public:
+
+  zipf_sampler_t(uint64 n = 1, double alpha = 1) {
+    initialize(n, alpha);
+  }
+
+  void initialize(uint64 n, double alpha) {
+    _n = (n > 0 ? n : 1);
+    _alpha = alpha;
+    _hX1 = hIntegral(1.5) - 1;
+    _hN = hIntegral(_n + 0.5);
+    _s = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+  }
+
+  uint64 sample(xorshift_rng_t &rng) {
+    while (true) {
+      double u = _hN + rng.uniform() * (_hX1 - _hN);
+      double x = hIntegralInverse(u);
+      uint64 k = (uint64)(x + 0.5);
+      if (k < 1) k = 1;
+      else if (k > _n) k = _n;
+      if (k - x <= _s || u >= hIntegral(k + 0.5) - h(k))
+        return k;
+    }
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: SyntheticPattern
+// Description:
+//    Generates the byte offsets of the requests within a region.
+// -----------------------------------------------------------------------------
+
+class SyntheticPattern {
+
+protected:
+
+  uint64 _size;
+  uint32 _blockSize;
+  uint64 _blocks;
+
+public:
+
+  SyntheticPattern(uint64 size, uint32 blockSize) {
+    _blockSize = blockSize;
+    _blocks = size / blockSize;
+    if (_blocks == 0) _blocks = 1;
+    _size = _blocks * blockSize;
+  }
+
+  virtual ~SyntheticPattern() {}
+
+  // offset of the next request
+  virtual uint64 Next(xorshift_rng_t &rng) = 0;
+
+  // true if each request depends on the previous one of the pattern
+  virtual bool Dependent() { return false; }
+};
+
+
+// -----------------------------------------------------------------------------
+// Strided (and sequential) walk
+// -----------------------------------------------------------------------------
+
+class StridePattern : public SyntheticPattern {
+
+protected:
+
+  uint64 _stride;
+  uint64 _position;
+
+public:
+
+  StridePattern(uint64 size, uint32 blockSize, uint64 stride)
+    : SyntheticPattern(size, blockSize) {
+    _stride = stride % _size;
+    _position = 0;
+  }
+
+  uint64 Next(xorshift_rng_t &rng) {
+    uint64 offset = _position;
+    _position += _stride;
+    if (_position >= _size) _position -= _size;
+    return offset;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Uniform random blocks
+// -----------------------------------------------------------------------------
+
+class RandomPattern : public SyntheticPattern {
+
+public:
+
+  RandomPattern(uint64 size, uint32 blockSize)
+    : SyntheticPattern(size, blockSize) {}
+
+  uint64 Next(xorshift_rng_t &rng) {
+    return rng.below(_blocks) * _blockSize;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Zipfian blocks. Ranks are scattered over the region by an affine map
+// modulo the number of blocks, so the hot blocks do not share a few sets
+// -----------------------------------------------------------------------------
+
+class ZipfPattern : public SyntheticPattern {
+
+protected:
+
+  zipf_sampler_t _zipf;
+  uint64 _multiplier;
+  uint64 _shift;
+
+  static uint64 gcd(uint64 a, uint64 b) {
+    while (b != 0) { uint64 t = a % b; a = b; b = t; }
+    return a;
+  }
+
+public:
+
+  ZipfPattern(uint64 size, uint32 blockSize, double alpha,
+              xorshift_rng_t &rng)
+    : SyntheticPattern(size, blockSize), _zipf(_blocks, alpha) {
+    _multiplier = (rng.below(_blocks) | 1);
+    while (gcd(_multiplier, _blocks) != 1)
+      _multiplier ++;
+    _shift = rng.below(_blocks);
+  }
+
+  uint64 Next(xorshift_rng_t &rng) {
+    uint64 rank = _zipf.sample(rng) - 1;
+    uint64 block = (rank * _multiplier + _shift) % _blocks;
+    return block * _blockSize;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Pointer chase. A full period LCG over the next power of two, skipping the
+// values past the last block, visits all the blocks in one random-looking
+// cycle without storing the permutation
+// -----------------------------------------------------------------------------
+
+class ChasePattern : public SyntheticPattern {
+
+protected:
+
+  uint64 _modulus;
+  uint64 _a;
+  uint64 _c;
+  uint64 _current;
+
+public:
+
+  ChasePattern(uint64 size, uint32 blockSize, xorshift_rng_t &rng)
+    : SyntheticPattern(size, blockSize) {
+    _modulus = 1;
+    while (_modulus < _blocks) _modulus <<= 1;
+    // a = 1 mod 4 and c odd give the full period modulo a power of two
+    _a = ((rng.next() << 2) | 1) & (_modulus - 1);
+    if (_modulus >= 4 && _a == 1) _a = 5 & (_modulus - 1);
+    _c = (rng.next() | 1) & (_modulus - 1);
+    _current = rng.below(_blocks);
+  }
+
+  uint64 Next(xorshift_rng_t &rng) {
+    do {
+      _current = (_a * _current + _c) & (_modulus - 1);
+    } while (_current >= _blocks);
+    return _current * _blockSize;
+  }
+
+  bool Dependent() { return true; }
+};
+
+
+// -----------------------------------------------------------------------------
+// Streaming with reuse
+// -----------------------------------------------------------------------------
+
+class StreamPattern : public SyntheticPattern {
+
+protected:
+
+  double _reuse;
+  uint64 _window;
+  uint64 _next;
+  uint64 _streamed;
+
+public:
+
+  StreamPattern(uint64 size, uint32 blockSize, double reuse, uint64 window)
+    : SyntheticPattern(size, blockSize) {
+    _reuse = reuse;
+    _window = (window > 0 ? window : 1);
+    _next = 0;
+    _streamed = 0;
+  }
+
+  uint64 Next(xorshift_rng_t &rng) {
+    if (_streamed > 0 && rng.uniform() < _reuse) {
+      uint64 back = 1 + rng.below(min(_window, min(_streamed, _blocks)));
+      return ((_next + _blocks - back) % _blocks) * _blockSize;
+    }
+    uint64 block = _next;
+    _next ++;
+    if (_next == _blocks) _next = 0;
+    _streamed ++;
+    return block * _blockSize;
+  }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: SyntheticTrace
+// Description:
+//    Generates the requests of a cpu from the phases and regions.
+// -----------------------------------------------------------------------------
+
 class SyntheticTrace {
 
 protected:
 
+  struct Region {
+    SyntheticPattern *pattern;
+    addr_t offset;
+    uint32 weight;
+    double write;
+    addr_t ip;
+    uint64 lastIcount;
+  };
+
+  struct Phase {
+    uint64 length;
+    uint32 memInstGap;
+    uint32 totalWeight;
+    vector <Region> regions;
+  };
+
   uint32 _blockSize;
-  uint32 _workingSetSize;
-  uint32 _memInstGap;
   uint32 _cpuID;
 
+  vector <Phase> _phases;
+  uint32 _phase;
+  uint64 _phaseEnd;
+
+  xorshift_rng_t _rng;
 
   uint64 _icount;
   addr_t _vaddr;
   addr_t _paddr;
 
-  cyclic_pointer _index;
 
-  
   uint64 Normalize(uint64 val) {
     return (val + ((addr_t)(_cpuID) << 48));
   }
 
 
+  // ---------------------------------------------------------------------------
+  // Function to add a region to the last phase
+  // ---------------------------------------------------------------------------
+
+  void AddRegion(string pattern, uint64 size, addr_t offset, uint32 weight,
+                 double write, uint64 stride, double alpha, double reuse,
+                 uint64 window) {
+
+    Region region;
+    if (pattern == "sequential")
+      region.pattern = new StridePattern(size, _blockSize, _blockSize);
+    else if (pattern == "stride")
+      region.pattern = new StridePattern(size, _blockSize, stride);
+    else if (pattern == "random")
+      region.pattern = new RandomPattern(size, _blockSize);
+    else if (pattern == "zipf")
+      region.pattern = new ZipfPattern(size, _blockSize, alpha, _rng);
+    else if (pattern == "chase")
+      region.pattern = new ChasePattern(size, _blockSize, _rng);
+    else if (pattern == "stream")
+      region.pattern = new StreamPattern(size, _blockSize, reuse, window);
+    else {
+      fprintf(stderr, "Unknown synthetic pattern `%s'\n", pattern.c_str());
+      exit(1);
+    }
+
+    Phase &phase = _phases.back();
+    region.offset = offset;
+    region.weight = weight;
+    region.write = write;
+    region.ip = 0xdeadbeef + 4 * phase.regions.size();
+    region.lastIcount = 0;
+    phase.regions.push_back(region);
+    phase.totalWeight += weight;
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to start a new phase
+  // ---------------------------------------------------------------------------
+
+  void AddPhase(uint64 length, uint32 memInstGap) {
+    Phase phase;
+    phase.length = length;
+    phase.memInstGap = memInstGap;
+    phase.totalWeight = 0;
+    _phases.push_back(phase);
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to read a spec file
+  // ---------------------------------------------------------------------------
+
+  void ReadSpec(string specFile, uint32 memInstGap) {
+
+    FILE *file = fopen(specFile.c_str(), "r");
+    if (file == NULL) {
+      fprintf(stderr, "Synthetic spec `%s' not found\n", specFile.c_str());
+      exit(1);
+    }
+
+    uint64 seed = 1;
+    uint32 gap = memInstGap;
+    addr_t layout = 0;
+    bool seeded = false;
+
+    char line[300];
+    while (fgets(line, 300, file)) {
+      string str(line);
+      if (str.find('#') != string::npos)
+        str = str.substr(0, str.find('#'));
+      istringstream istr(str);
+      string keyword;
+      if (!(istr >> keyword))
+        continue;
+
+      if (keyword == "seed") {
+        istr >> seed;
+      }
+      else if (keyword == "block-size") {
+        istr >> _blockSize;
+      }
+      else if (keyword == "gap") {
+        istr >> gap;
+        if (!_phases.empty())
+          _phases.back().memInstGap = gap;
+      }
+      else if (keyword == "phase") {
+        uint64 length = 0;
+        istr >> length;
+        AddPhase(length, gap);
+      }
+      else if (keyword == "region") {
+        // the patterns draw from the generator, so it is seeded before the
+        // first one
+        if (!seeded) {
+          _rng.seed(seed ^ ((uint64)_cpuID * 0x9e3779b97f4a7c15ULL));
+          seeded = true;
+        }
+        if (_phases.empty())
+          AddPhase(0, gap);
+
+        string pattern;
+        uint64 size = 0;
+        istr >> pattern >> size;
+        if (size == 0) {
+          fprintf(stderr, "Synthetic region `%s' has no size\n",
+                  pattern.c_str());
+          exit(1);
+        }
+
+        addr_t offset = layout;
+        uint32 weight = 1;
+        double write = 0;
+        uint64 stride = 2 * _blockSize;
+        double alpha = 0.99;
+        double reuse = 0.5;
+        uint64 window = 64;
+
+        string option;
+        while (istr >> option) {
+          if (option == "weight") istr >> weight;
+          else if (option == "write") istr >> write;
+          else if (option == "offset") { istr >> offset; offset *= 1024; }
+          else if (option == "stride") istr >> stride;
+          else if (option == "alpha") istr >> alpha;
+          else if (option == "reuse") istr >> reuse;
+          else if (option == "window") istr >> window;
+          else {
+            fprintf(stderr, "Unknown synthetic region option `%s'\n",
+                    option.c_str());
+            exit(1);
+          }
+        }
+
+        if (weight == 0) {
+          fprintf(stderr, "Synthetic region `%s' has weight 0\n",
+                  pattern.c_str());
+          exit(1);
+        }
+
+        AddRegion(pattern, size * 1024, offset, weight, write, stride,
+                  alpha, reuse, window);
+        layout = max(layout, offset + size * 1024);
+      }
+      else {
+        fprintf(stderr, "Unknown synthetic spec keyword `%s'\n",
+                keyword.c_str());
+        exit(1);
+      }
+    }
+    fclose(file);
+
+    for (uint32 i = 0; i < _phases.size(); i ++) {
+      if (_phases[i].regions.empty()) {
+        fprintf(stderr, "Synthetic phase %u has no region\n", i);
+        exit(1);
+      }
+    }
+    if (_phases.empty()) {
+      fprintf(stderr, "Synthetic spec `%s' has no region\n",
+              specFile.c_str());
+      exit(1);
+    }
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Function to rewind the instruction count to the first phase
+  // ---------------------------------------------------------------------------
+
+  void Start() {
+    _icount = 1;
+    _vaddr = 0xdead0000;
+    _paddr = 0xbeef0000;
+    _phase = 0;
+    _phaseEnd = _phases[0].length;
+  }
+
+
 public:
 
+  // ---------------------------------------------------------------------------
+  // Constructor. A cyclic sequential read walk over the working set
+  // ---------------------------------------------------------------------------
+
   SyntheticTrace(uint32 workingSetSize = 128,
-                 uint32 memInstGap = 50, uint32 cpuID = 0, uint32 blockSize = 64)
-    : _index(workingSetSize * 1024 / blockSize) {
+                 uint32 memInstGap = 50, uint32 cpuID = 0, uint32 blockSize = 64) {
     _blockSize = blockSize;
-    _workingSetSize = workingSetSize;
-    _memInstGap = memInstGap;
     _cpuID = cpuID;
+    _rng.seed(cpuID);
 
-    _icount = 1;
-    _vaddr = 0xdead0000;
-    _paddr = 0xbeef0000;
+    AddPhase(0, memInstGap);
+    AddRegion("sequential", (uint64)workingSetSize * 1024, 0, 1, 0,
+              blockSize, 0, 0, 0);
+    Start();
+  }
+
+
+  // ---------------------------------------------------------------------------
+  // Constructor. Phases and regions from a spec file. The gap is used by
+  // the phases that do not set one
+  // ---------------------------------------------------------------------------
+
+  SyntheticTrace(string specFile, uint32 memInstGap, uint32 cpuID) {
+    _blockSize = 64;
+    _cpuID = cpuID;
+    ReadSpec(specFile, memInstGap);
+    Start();
+  }
+
+
+  ~SyntheticTrace() {
+    for (uint32 i = 0; i < _phases.size(); i ++)
+      for (uint32 j = 0; j < _phases[i].regions.size(); j ++)
+        delete _phases[i].regions[j].pattern;
   }
 
 
+  // ---------------------------------------------------------------------------
+  // Function to get the next request
+  // ---------------------------------------------------------------------------
+
   MemoryRequest *NextRequest() {
+
+    // move to the next phase, cyclically
+    while (_phaseEnd != 0 && _icount > _phaseEnd) {
+      _phase = (_phase + 1) % _phases.size();
+      _phaseEnd = (_phases[_phase].length == 0 ? 0 :
+                   _phaseEnd + _phases[_phase].length);
+    }
+    Phase &phase = _phases[_phase];
+
+    // pick a region by weight
+    uint32 r = 0;
+    if (phase.regions.size() > 1) {
+      uint64 pick = _rng.below(phase.totalWeight);
+      while (pick >= phase.regions[r].weight) {
+        pick -= phase.regions[r].weight;
+        r ++;
+      }
+    }
+    Region &region = phase.regions[r];
+    uint64 offset = region.offset + region.pattern -> Next(_rng);
+
     MemoryRequest *request = new MemoryRequest;
 
     request -> type = MemoryRequest::READ;
+    if (region.write > 0 && _rng.uniform() < region.write)
+      request -> type = MemoryRequest::WRITE;
     request -> iniType = MemoryRequest::CPU;
     request -> cpuID = _cpuID;
 
-    request -> virtualAddress = Normalize(_vaddr + _index * _blockSize);
-    request -> physicalAddress = Normalize(_paddr + _index * _blockSize);
-    request -> ip = Normalize(0xdeadbeef);
+    request -> virtualAddress = Normalize(_vaddr + offset);
+    request -> physicalAddress = Normalize(_paddr + offset);
+    request -> ip = Normalize(region.ip);
     request -> icount = _icount;
     request -> size = 8;
     request -> iniPtr = NULL;
 
-    _icount += _memInstGap;
-    _index.increment();
+    if (region.pattern -> Dependent())
+      request -> depIcount = region.lastIcount;
+    region.lastIcount = _icount;
+
+    _icount += phase.memInstGap;
 
     return request;
   }
-  
+
 };
 
 #endif // __SYNTHETIC_TRACE_H__
@@ -0,0 +1,281 @@
+// -----------------------------------------------------------------------------
+// File: TraceCodec.h
+// Description:
+//    This file defines the compression codecs of chunked traces and the
+//    thread pool that compresses and decompresses their chunks. zlib is
+//    always available. zstd and LZ4 are compiled in with -DZSTD and -DLZ4
+//    (and linked with -lzstd and -llz4).
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_CODEC_H__
+#define __TRACE_CODEC_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+#ifdef LZ4
+#include <lz4.h>
+#endif
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+// codecs. gzip chunks are plain gzip members, the others are framed in a
+// chunk container (see TraceIndex.h)
+#define TRACE_CODEC_GZIP 0
+#define TRACE_CODEC_ZLIB 1
+#define TRACE_CODEC_ZSTD 2
+#define TRACE_CODEC_LZ4 3
+
+
+// -----------------------------------------------------------------------------
+// Function to get a codec from its name. Returns -1 if it is unknown or not
+// compiled in
+// -----------------------------------------------------------------------------
+
+inline int32 TraceCodecFromName(string name) {
+  if (name == "gzip") return TRACE_CODEC_GZIP;
+  if (name == "zlib") return TRACE_CODEC_ZLIB;
+#ifdef ZSTD
+  if (name == "zstd") return TRACE_CODEC_ZSTD;
+#endif
+#ifdef LZ4
+  if (name == "lz4") return TRACE_CODEC_LZ4;
+#endif
+  return -1;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to compress a chunk
+// -----------------------------------------------------------------------------
+
+inline bool TraceCompress(uint32 codec, const char *in, uint32 size,
+                          vector <char> &out) {
+
+  switch (codec) {
+
+    case TRACE_CODEC_GZIP: {
+      z_stream stream;
+      stream.zalloc = Z_NULL;
+      stream.zfree = Z_NULL;
+      stream.opaque = Z_NULL;
+      // 16 + window bits writes a gzip header and trailer
+      if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+      out.resize(deflateBound(&stream, size));
+      stream.next_in = (Bytef *)in;
+      stream.avail_in = size;
+      stream.next_out = (Bytef *)&out[0];
+      stream.avail_out = out.size();
+      int ret = deflate(&stream, Z_FINISH);
+      out.resize(out.size() - stream.avail_out);
+      deflateEnd(&stream);
+      return (ret == Z_STREAM_END);
+    }
+
+    case TRACE_CODEC_ZLIB: {
+      uLongf length = compressBound(size);
+      out.resize(length);
+      if (compress2((Bytef *)&out[0], &length, (const Bytef *)in, size,
+                    Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+      out.resize(length);
+      return true;
+    }
+
+#ifdef ZSTD
+    case TRACE_CODEC_ZSTD: {
+      out.resize(ZSTD_compressBound(size));
+      size_t length = ZSTD_compress(&out[0], out.size(), in, size, 3);
+      if (ZSTD_isError(length))
+        return false;
+      out.resize(length);
+      return true;
+    }
+#endif
+
+#ifdef LZ4
+    case TRACE_CODEC_LZ4: {
+      out.resize(LZ4_compressBound(size));
+      int length = LZ4_compress_default(in, &out[0], size, out.size());
+      if (length <= 0)
+        return false;
+      out.resize(length);
+      return true;
+    }
+#endif
+  }
+
+  return false;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to decompress a chunk of a known raw size
+// -----------------------------------------------------------------------------
+
+inline bool TraceDecompress(uint32 codec, const char *in, uint32 size,
+                            char *out, uint32 rawSize) {
+
+  switch (codec) {
+
+    case TRACE_CODEC_ZLIB: {
+      uLongf length = rawSize;
+      return (uncompress((Bytef *)out, &length, (const Bytef *)in, size)
+              == Z_OK && length == rawSize);
+    }
+
+#ifdef ZSTD
+    case TRACE_CODEC_ZSTD: {
+      size_t length = ZSTD_decompress(out, rawSize, in, size);
+      return (!ZSTD_isError(length) && length == rawSize);
+    }
+#endif
+
+#ifdef LZ4
+    case TRACE_CODEC_LZ4:
+      return (LZ4_decompress_safe(in, out, size, rawSize) == (int)rawSize);
+#endif
+  }
+
+  return false;
+}
+
+
+// -----------------------------------------------------------------------------
+// Class: trace_thread_pool_t
+// Description:
+//    Runs trace jobs on worker threads. Without threads, a job runs when it
+//    is submitted.
+// -----------------------------------------------------------------------------
+
+class trace_thread_pool_t {
+
+  public:
+
+    struct job_t {
+      bool done;
+      virtual void Run() = 0;
+      virtual ~job_t() {}
+    };
+
+  protected:
+
+    vector <pthread_t> _threads;
+    deque <job_t *> _jobs;
+    bool _stop;
+
+    pthread_mutex_t _lock;
+    pthread_cond_t _submitted;
+    pthread_cond_t _completed;
+
+
+    static void *Worker(void *arg) {
+      trace_thread_pool_t *pool = (trace_thread_pool_t *)arg;
+      pthread_mutex_lock(&pool -> _lock);
+      while (true) {
+        while (pool -> _jobs.empty() && !pool -> _stop)
+          pthread_cond_wait(&pool -> _submitted, &pool -> _lock);
+        if (pool -> _jobs.empty())
+          break;
+        job_t *job = pool -> _jobs.front();
+        pool -> _jobs.pop_front();
+        pthread_mutex_unlock(&pool -> _lock);
+        job -> Run();
+        pthread_mutex_lock(&pool -> _lock);
+        job -> done = true;
+        pthread_cond_broadcast(&pool -> _completed);
+      }
+      pthread_mutex_unlock(&pool -> _lock);
+      return NULL;
+    }
+
+
+  public:
+
+    trace_thread_pool_t() {
+      _stop = false;
+      pthread_mutex_init(&_lock, NULL);
+      pthread_cond_init(&_submitted, NULL);
+      pthread_cond_init(&_completed, NULL);
+    }
+
+    ~trace_thread_pool_t() {
+      pthread_mutex_lock(&_lock);
+      _stop = true;
+      pthread_cond_broadcast(&_submitted);
+      pthread_mutex_unlock(&_lock);
+      for (uint32 i = 0; i < _threads.size(); i ++)
+        pthread_join(_threads[i], NULL);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add worker threads
+    // -------------------------------------------------------------------------
+
+    void Start(uint32 threads) {
+      while (_threads.size() < threads) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, Worker, this);
+        _threads.push_back(thread);
+      }
+    }
+
+    uint32 Threads() { return _threads.size(); }
+
+
+    // -------------------------------------------------------------------------
+    // Functions to submit a job and to wait for it
+    // -------------------------------------------------------------------------
+
+    void Submit(job_t *job) {
+      job -> done = false;
+      if (_threads.empty()) {
+        job -> Run();
+        job -> done = true;
+        return;
+      }
+      pthread_mutex_lock(&_lock);
+      _jobs.push_back(job);
+      pthread_cond_signal(&_submitted);
+      pthread_mutex_unlock(&_lock);
+    }
+
+    void Wait(job_t *job) {
+      if (_threads.empty())
+        return;
+      pthread_mutex_lock(&_lock);
+      while (!job -> done)
+        pthread_cond_wait(&_completed, &_lock);
+      pthread_mutex_unlock(&_lock);
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// The pool shared by all the trace readers and writers
+// -----------------------------------------------------------------------------
+
+inline trace_thread_pool_t &TraceThreadPool() {
+  static trace_thread_pool_t pool;
+  return pool;
+}
+
+#endif // __TRACE_CODEC_H__
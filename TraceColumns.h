@@ -0,0 +1,282 @@
+// -----------------------------------------------------------------------------
+// File: TraceColumns.h
+// Description:
+//    Defines a trace record, its text form and the columnar form of a chunk
+//    of records. The text form is a line "icount ip vaddr paddr size type
+//    [dep]" (see TraceReader.h).
+//
+//    The columnar form stores each field of the chunk in its own column,
+//    as variable-length integers (7 bits per byte, low bits first):
+//
+//      icount    delta from the previous record (zigzag)
+//      ip        index in the dictionary of the chunk. The next unused
+//                index adds the ip to the dictionary
+//      ip dict   the ips of the dictionary, as deltas (zigzag)
+//      vaddr     delta from the previous address of the same ip (zigzag).
+//                An ip seen for the first time takes the delta from the
+//                previous record
+//      paddr     change of paddr - vaddr from the previous record (zigzag)
+//      size/type size << 3 | type
+//      dep       dependency distance
+//
+//    The chunk starts with the byte sizes of the columns (uint32 each, in
+//    the byte order of the host). A chunk is encoded on its own, so it can
+//    be decoded without the rest of the trace.
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_COLUMNS_H__
+#define __TRACE_COLUMNS_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+#define TRACE_COLUMNS 7
+
+// types take the low 3 bits of the size/type column
+#define TRACE_TYPE_BITS 3
+
+
+// -----------------------------------------------------------------------------
+// A trace record
+// -----------------------------------------------------------------------------
+
+struct TraceRecord {
+  uint64 icount;
+  uint64 ip;
+  uint64 virtualAddress;
+  uint64 physicalAddress;
+  uint32 size;
+  uint32 type;
+  uint32 dep;
+};
+
+
+// -----------------------------------------------------------------------------
+// Function to parse a text record. Returns false if the line is not one
+// -----------------------------------------------------------------------------
+
+inline bool ParseTraceRecord(const char *line, TraceRecord &record) {
+  char *end;
+  record.icount = strtoull(line, &end, 10);
+  if (end == line)
+    return false;
+  line = end;
+  record.ip = strtoull(line, &end, 10);
+  record.virtualAddress = strtoull(end, &end, 10);
+  record.physicalAddress = strtoull(end, &end, 10);
+  record.size = strtoul(end, &end, 10);
+  const char *type = end;
+  record.type = strtoul(type, &end, 10);
+  if (end == type)
+    return false;
+  record.dep = strtoul(end, &end, 10);
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to format a record as a text line. Returns its length
+// -----------------------------------------------------------------------------
+
+inline uint32 FormatTraceRecord(const TraceRecord &record, char *line,
+                                uint32 size) {
+  int length;
+  if (record.dep != 0)
+    length = snprintf(line, size, "%llu %llu %llu %llu %u %u %u\n",
+                      record.icount, record.ip, record.virtualAddress,
+                      record.physicalAddress, record.size, record.type,
+                      record.dep);
+  else
+    length = snprintf(line, size, "%llu %llu %llu %llu %u %u\n",
+                      record.icount, record.ip, record.virtualAddress,
+                      record.physicalAddress, record.size, record.type);
+  return (length < (int)size ? length : size - 1);
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions to write and read variable-length integers
+// -----------------------------------------------------------------------------
+
+inline void PutVarint(vector <char> &column, uint64 value) {
+  while (value >= 0x80) {
+    column.push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  column.push_back((char)value);
+}
+
+inline void PutZigzag(vector <char> &column, uint64 delta) {
+  PutVarint(column, (delta << 1) ^ (uint64)((int64)delta >> 63));
+}
+
+inline uint64 GetVarint(const uint8 *&data, const uint8 *end) {
+  uint64 value = 0;
+  uint32 shift = 0;
+  while (data < end && shift < 64) {
+    uint8 byte = *(data ++);
+    value |= (uint64)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      break;
+    shift += 7;
+  }
+  return value;
+}
+
+inline uint64 GetZigzag(const uint8 *&data, const uint8 *end) {
+  uint64 value = GetVarint(data, end);
+  return (value >> 1) ^ (0 - (value & 1));
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to encode a chunk of records into columns. Returns false if a
+// record does not fit the columns
+// -----------------------------------------------------------------------------
+
+inline bool EncodeTraceColumns(const vector <TraceRecord> &records,
+                               vector <char> &out) {
+
+  vector <char> columns[TRACE_COLUMNS];
+  map <uint64, uint32> dictionary;
+  vector <uint64> lastAddress;
+  uint64 icount = 0;
+  uint64 ip = 0;
+  uint64 address = 0;
+  uint64 translation = 0;
+
+  for (uint32 i = 0; i < records.size(); i ++) {
+    const TraceRecord &record = records[i];
+    if (record.type >= (1U << TRACE_TYPE_BITS))
+      return false;
+
+    PutZigzag(columns[0], record.icount - icount);
+    icount = record.icount;
+
+    // ip and the address stream of the ip
+    map <uint64, uint32>::iterator entry = dictionary.find(record.ip);
+    uint64 previous = address;
+    if (entry == dictionary.end()) {
+      uint32 index = dictionary.size();
+      dictionary[record.ip] = index;
+      lastAddress.push_back(0);
+      PutVarint(columns[1], index);
+      PutZigzag(columns[2], record.ip - ip);
+      ip = record.ip;
+      entry = dictionary.find(record.ip);
+    }
+    else {
+      PutVarint(columns[1], entry -> second);
+      previous = lastAddress[entry -> second];
+    }
+    PutZigzag(columns[3], record.virtualAddress - previous);
+    lastAddress[entry -> second] = record.virtualAddress;
+    address = record.virtualAddress;
+
+    PutZigzag(columns[4], (record.physicalAddress - record.virtualAddress) -
+              translation);
+    translation = record.physicalAddress - record.virtualAddress;
+
+    PutVarint(columns[5], ((uint64)record.size << TRACE_TYPE_BITS) |
+              record.type);
+    PutVarint(columns[6], record.dep);
+  }
+
+  out.clear();
+  for (uint32 c = 0; c < TRACE_COLUMNS; c ++) {
+    uint32 size = columns[c].size();
+    out.insert(out.end(), (char *)&size, (char *)&size + sizeof(size));
+  }
+  for (uint32 c = 0; c < TRACE_COLUMNS; c ++)
+    out.insert(out.end(), columns[c].begin(), columns[c].end());
+  return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// Function to decode a chunk of a known number of records. Returns false if
+// the columns are corrupt
+// -----------------------------------------------------------------------------
+
+inline bool DecodeTraceColumns(const char *in, uint32 size, uint32 count,
+                               vector <TraceRecord> &records) {
+
+  uint32 sizes[TRACE_COLUMNS];
+  if (size < sizeof(sizes))
+    return false;
+  memcpy(sizes, in, sizeof(sizes));
+
+  const uint8 *data[TRACE_COLUMNS];
+  const uint8 *end[TRACE_COLUMNS];
+  uint64 offset = sizeof(sizes);
+  for (uint32 c = 0; c < TRACE_COLUMNS; c ++) {
+    data[c] = (const uint8 *)in + offset;
+    offset += sizes[c];
+    end[c] = (const uint8 *)in + offset;
+  }
+  if (offset != size)
+    return false;
+
+  vector <uint64> dictionary;
+  vector <uint64> lastAddress;
+  uint64 icount = 0;
+  uint64 ip = 0;
+  uint64 address = 0;
+  uint64 translation = 0;
+
+  records.resize(count);
+  for (uint32 i = 0; i < count; i ++) {
+    TraceRecord &record = records[i];
+
+    icount += GetZigzag(data[0], end[0]);
+    record.icount = icount;
+
+    uint64 index = GetVarint(data[1], end[1]);
+    uint64 previous = address;
+    if (index == dictionary.size()) {
+      ip += GetZigzag(data[2], end[2]);
+      dictionary.push_back(ip);
+      lastAddress.push_back(0);
+    }
+    else if (index < dictionary.size()) {
+      previous = lastAddress[index];
+    }
+    else {
+      return false;
+    }
+    record.ip = dictionary[index];
+    record.virtualAddress = previous + GetZigzag(data[3], end[3]);
+    lastAddress[index] = record.virtualAddress;
+    address = record.virtualAddress;
+
+    translation += GetZigzag(data[4], end[4]);
+    record.physicalAddress = record.virtualAddress + translation;
+
+    uint64 sizeType = GetVarint(data[5], end[5]);
+    record.size = sizeType >> TRACE_TYPE_BITS;
+    record.type = sizeType & ((1U << TRACE_TYPE_BITS) - 1);
+    record.dep = GetVarint(data[6], end[6]);
+  }
+
+  for (uint32 c = 0; c < TRACE_COLUMNS; c ++)
+    if (data[c] != end[c])
+      return false;
+  return true;
+}
+
+#endif // __TRACE_COLUMNS_H__
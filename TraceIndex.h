@@ -0,0 +1,628 @@
+// -----------------------------------------------------------------------------
+// File: TraceIndex.h
+// Description:
+//    Defines the index of a chunked trace, and a writer and a reader for
+//    chunked traces. A chunked trace is made of independently compressed
+//    chunks of a fixed number of records, so decompression can start at any
+//    chunk, and chunks can be (de)compressed in parallel.
+//
+//    With gzip, the chunks are gzip members, so the trace is still read by
+//    any gzip reader. The index (trace file name + ".idx") lists a seek
+//    point per member:
+//
+//      first <icount of the first record>
+//      <record number> <icount> <byte offset>
+//      ...
+//
+//    With the other codecs (see TraceCodec.h), the trace is a chunk
+//    container: the magic TRACE_CHUNK_MAGIC and the codec, then each chunk
+//    as a ChunkHeader followed by the compressed records. The chunk headers
+//    are the index. Integers are stored in the byte order of the host.
+//
+//    The records of a container chunk are text lines, or columns (see
+//    TraceColumns.h). Columnar traces are always containers, so a columnar
+//    trace written with gzip is a zlib container.
+// -----------------------------------------------------------------------------
+
+#ifndef __TRACE_INDEX_H__
+#define __TRACE_INDEX_H__
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "Types.h"
+#include "TraceCodec.h"
+#include "TraceColumns.h"
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// default number of records in a chunk
+#define TRACE_CHUNK_RECORDS 65536
+
+// first bytes of a chunk container
+#define TRACE_CHUNK_MAGIC "TRCHUNK1"
+
+// layouts of the records in a chunk
+#define TRACE_LAYOUT_TEXT 0
+#define TRACE_LAYOUT_COLUMNAR 1
+
+// header of a chunk in a chunk container
+struct ChunkHeader {
+  uint64 firstIcount;
+  uint32 records;
+  uint32 rawSize;
+  uint32 compressedSize;
+  uint32 layout;
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: TraceIndex
+// Description:
+//    Seek points of a chunked trace.
+// -----------------------------------------------------------------------------
+
+class TraceIndex {
+
+  public:
+
+    struct SeekPoint {
+      uint64 record;
+      uint64 icount;
+      uint64 offset;
+    };
+
+    uint64 firstIcount;
+    vector <SeekPoint> points;
+
+
+    // -------------------------------------------------------------------------
+    // Function to read the index of a trace. Returns false if there is none
+    // -------------------------------------------------------------------------
+
+    bool Read(string traceFileName) {
+      points.clear();
+      FILE *file = fopen((traceFileName + ".idx").c_str(), "r");
+      if (file == NULL)
+        return false;
+
+      char line[300];
+      bool first = false;
+      while (fgets(line, 300, file)) {
+        SeekPoint point;
+        if (line[0] == '#')
+          continue;
+        if (sscanf(line, "first %llu", &firstIcount) == 1) {
+          first = true;
+          continue;
+        }
+        if (sscanf(line, "%llu %llu %llu", &point.record, &point.icount,
+                   &point.offset) != 3)
+          continue;
+        points.push_back(point);
+      }
+      fclose(file);
+
+      if (!first || points.empty()) {
+        points.clear();
+        return false;
+      }
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the index of a trace
+    // -------------------------------------------------------------------------
+
+    void Write(string traceFileName) {
+      FILE *file = fopen((traceFileName + ".idx").c_str(), "w");
+      if (file == NULL) {
+        fprintf(stderr, "Cannot write trace index `%s.idx'\n",
+                traceFileName.c_str());
+        exit(1);
+      }
+      fprintf(file, "first %llu\n", firstIcount);
+      for (uint32 i = 0; i < points.size(); i ++)
+        fprintf(file, "%llu %llu %llu\n", points[i].record, points[i].icount,
+                points[i].offset);
+      fclose(file);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to find the last seek point at or before an icount
+    // -------------------------------------------------------------------------
+
+    SeekPoint Find(uint64 icount) {
+      uint32 low = 0;
+      uint32 high = points.size();
+      while (high - low > 1) {
+        uint32 mid = (low + high) / 2;
+        if (points[mid].icount <= icount) low = mid;
+        else high = mid;
+      }
+      return points[low];
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: ChunkedTraceWriter
+// Description:
+//    Writes trace records into a chunked trace and builds its index. The
+//    chunks are encoded and compressed on the trace thread pool, and written
+//    in order.
+// -----------------------------------------------------------------------------
+
+class ChunkedTraceWriter {
+
+  protected:
+
+    struct CompressJob : public trace_thread_pool_t::job_t {
+      uint32 codec;
+      uint32 layout;
+      string raw;
+      vector <TraceRecord> columns;
+      vector <char> compressed;
+      uint64 firstIcount;
+      uint32 records;
+      uint32 rawSize;
+      bool ok;
+
+      void Run() {
+        if (layout == TRACE_LAYOUT_COLUMNAR) {
+          vector <char> encoded;
+          ok = EncodeTraceColumns(columns, encoded);
+          rawSize = encoded.size();
+          if (ok)
+            ok = TraceCompress(codec, &encoded[0], rawSize, compressed);
+        }
+        else {
+          rawSize = raw.size();
+          ok = TraceCompress(codec, raw.data(), rawSize, compressed);
+        }
+      }
+    };
+
+    string _traceFileName;
+    uint32 _chunkRecords;
+    uint32 _codec;
+    uint32 _layout;
+
+    FILE *_file;
+    uint64 _offset;
+    uint64 _records;
+    uint64 _skipped;
+    uint64 _written;
+    CompressJob *_chunk;
+    deque <CompressJob *> _inFlight;
+    TraceIndex _index;
+
+
+    // -------------------------------------------------------------------------
+    // Function to write the oldest chunk in flight
+    // -------------------------------------------------------------------------
+
+    void WriteOldest() {
+      CompressJob *job = _inFlight.front();
+      _inFlight.pop_front();
+      TraceThreadPool().Wait(job);
+      if (!job -> ok) {
+        fprintf(stderr, "Cannot compress trace `%s'\n",
+                _traceFileName.c_str());
+        exit(1);
+      }
+
+      if (_codec == TRACE_CODEC_GZIP) {
+        TraceIndex::SeekPoint point;
+        point.record = _written;
+        point.icount = job -> firstIcount;
+        point.offset = _offset;
+        _index.points.push_back(point);
+      }
+      else {
+        ChunkHeader header;
+        header.firstIcount = job -> firstIcount;
+        header.records = job -> records;
+        header.rawSize = job -> rawSize;
+        header.compressedSize = job -> compressed.size();
+        header.layout = job -> layout;
+        fwrite(&header, sizeof(header), 1, _file);
+        _offset += sizeof(header);
+      }
+
+      fwrite(&job -> compressed[0], 1, job -> compressed.size(), _file);
+      _offset += job -> compressed.size();
+      _written += job -> records;
+      delete job;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to start a chunk if there is none
+    // -------------------------------------------------------------------------
+
+    void Begin(uint64 icount) {
+      if (_chunk != NULL)
+        return;
+      _chunk = new CompressJob;
+      _chunk -> codec = _codec;
+      _chunk -> layout = _layout;
+      _chunk -> firstIcount = icount;
+      _chunk -> records = 0;
+      if (_records == 0)
+        _index.firstIcount = icount;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to count a record of the current chunk
+    // -------------------------------------------------------------------------
+
+    void Added() {
+      _chunk -> records ++;
+      _records ++;
+      if (_chunk -> records == _chunkRecords)
+        Flush();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to send the current chunk for compression
+    // -------------------------------------------------------------------------
+
+    void Flush() {
+      if (_chunk == NULL)
+        return;
+      _inFlight.push_back(_chunk);
+      TraceThreadPool().Submit(_chunk);
+      _chunk = NULL;
+      // bound the memory held by the chunks in flight
+      while (_inFlight.size() > 2 * TraceThreadPool().Threads() + 1)
+        WriteOldest();
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Constructor
+    // -------------------------------------------------------------------------
+
+    ChunkedTraceWriter(string traceFileName,
+                       uint32 chunkRecords = TRACE_CHUNK_RECORDS,
+                       uint32 codec = TRACE_CODEC_GZIP,
+                       uint32 layout = TRACE_LAYOUT_TEXT) {
+      _traceFileName = traceFileName;
+      _chunkRecords = (chunkRecords > 0 ? chunkRecords : 1);
+      _codec = codec;
+      _layout = layout;
+      if (_layout == TRACE_LAYOUT_COLUMNAR && _codec == TRACE_CODEC_GZIP)
+        _codec = TRACE_CODEC_ZLIB;
+      _offset = 0;
+      _records = 0;
+      _skipped = 0;
+      _written = 0;
+      _chunk = NULL;
+      _file = fopen(traceFileName.c_str(), "wb");
+      if (_file == NULL) {
+        fprintf(stderr, "Cannot write trace `%s'\n", traceFileName.c_str());
+        exit(1);
+      }
+      if (_codec != TRACE_CODEC_GZIP) {
+        fwrite(TRACE_CHUNK_MAGIC, 1, 8, _file);
+        fwrite(&_codec, sizeof(_codec), 1, _file);
+        _offset = 8 + sizeof(_codec);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to add a record. The line is "icount ..." as in TraceReader.
+    // Lines that are not records (blank lines, comments) are skipped
+    // -------------------------------------------------------------------------
+
+    void Write(const char *line) {
+      TraceRecord record;
+      if (!ParseTraceRecord(line, record)) {
+        _skipped ++;
+        return;
+      }
+      if (_layout == TRACE_LAYOUT_COLUMNAR) {
+        Write(record);
+        return;
+      }
+      Begin(strtoull(line, NULL, 10));
+      _chunk -> raw += line;
+      if (_chunk -> raw[_chunk -> raw.size() - 1] != '\n')
+        _chunk -> raw += '\n';
+      Added();
+    }
+
+    void Write(const TraceRecord &record) {
+      if (_layout == TRACE_LAYOUT_TEXT) {
+        char line[300];
+        FormatTraceRecord(record, line, 300);
+        Write(line);
+        return;
+      }
+      Begin(record.icount);
+      _chunk -> columns.push_back(record);
+      Added();
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to finish the trace and write the index
+    // -------------------------------------------------------------------------
+
+    void Close() {
+      Flush();
+      while (!_inFlight.empty())
+        WriteOldest();
+      fclose(_file);
+      if (_codec == TRACE_CODEC_GZIP && _records > 0)
+        _index.Write(_traceFileName);
+    }
+
+    uint64 Records() { return _records; }
+    uint64 Skipped() { return _skipped; }
+};
+
+
+// -----------------------------------------------------------------------------
+// Class: ChunkedTraceInput
+// Description:
+//    Reads the records of a chunk container. The chunks after the current
+//    one are decompressed and decoded ahead on the trace thread pool.
+// -----------------------------------------------------------------------------
+
+class ChunkedTraceInput {
+
+  protected:
+
+    struct Chunk {
+      uint64 offset;
+      ChunkHeader header;
+    };
+
+    struct DecompressJob : public trace_thread_pool_t::job_t {
+      int fd;
+      uint32 codec;
+      Chunk chunk;
+      vector <char> compressed;
+      vector <char> raw;
+      vector <TraceRecord> records;
+      bool ok;
+      bool pending;
+
+      void Run() {
+        compressed.resize(chunk.header.compressedSize);
+        raw.resize(chunk.header.rawSize + 1);
+        ok = (pread(fd, &compressed[0], compressed.size(),
+                    chunk.offset + sizeof(ChunkHeader))
+              == (ssize_t)compressed.size());
+        if (ok)
+          ok = TraceDecompress(codec, &compressed[0], compressed.size(),
+                               &raw[0], chunk.header.rawSize);
+        if (!ok)
+          return;
+
+        if (chunk.header.layout == TRACE_LAYOUT_COLUMNAR) {
+          ok = DecodeTraceColumns(&raw[0], chunk.header.rawSize,
+                                  chunk.header.records, records);
+          return;
+        }
+
+        // text lines are parsed here too, off the reading thread
+        records.clear();
+        raw[chunk.header.rawSize] = '\0';
+        char *line = &raw[0];
+        while (*line != '\0') {
+          char *next = strchr(line, '\n');
+          if (next != NULL)
+            *(next ++) = '\0';
+          else
+            next = line + strlen(line);
+          TraceRecord record;
+          if (ParseTraceRecord(line, record))
+            records.push_back(record);
+          line = next;
+        }
+      }
+    };
+
+    string _traceFileName;
+    int _fd;
+    uint32 _codec;
+    vector <Chunk> _chunks;
+
+    // chunk c is decompressed in slot c % _slots.size()
+    vector <DecompressJob> _slots;
+    uint32 _current;
+    bool _ready;
+    uint32 _position;
+
+
+    // -------------------------------------------------------------------------
+    // Function to start decompressing a chunk
+    // -------------------------------------------------------------------------
+
+    void Schedule(uint32 chunk) {
+      if (chunk >= _chunks.size())
+        return;
+      DecompressJob &job = _slots[chunk % _slots.size()];
+      job.chunk = _chunks[chunk];
+      job.pending = true;
+      TraceThreadPool().Submit(&job);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to wait for all the chunks in flight
+    // -------------------------------------------------------------------------
+
+    void Drain() {
+      for (uint32 i = 0; i < _slots.size(); i ++) {
+        if (_slots[i].pending) {
+          TraceThreadPool().Wait(&_slots[i]);
+          _slots[i].pending = false;
+        }
+      }
+    }
+
+
+  public:
+
+    // -------------------------------------------------------------------------
+    // Function to check if a file is a chunk container
+    // -------------------------------------------------------------------------
+
+    static bool Detect(string traceFileName) {
+      char magic[8];
+      FILE *file = fopen(traceFileName.c_str(), "rb");
+      if (file == NULL)
+        return false;
+      bool detected = (fread(magic, 1, 8, file) == 8 &&
+                       memcmp(magic, TRACE_CHUNK_MAGIC, 8) == 0);
+      fclose(file);
+      return detected;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Constructor. Reads the chunk headers
+    // -------------------------------------------------------------------------
+
+    ChunkedTraceInput(string traceFileName) {
+      _traceFileName = traceFileName;
+      _fd = open(traceFileName.c_str(), O_RDONLY);
+      if (_fd < 0) {
+        fprintf(stderr, "Cannot read trace `%s'\n", traceFileName.c_str());
+        exit(1);
+      }
+
+      char magic[8];
+      uint64 offset = 8 + sizeof(_codec);
+      if (pread(_fd, magic, 8, 0) != 8 ||
+          pread(_fd, &_codec, sizeof(_codec), 8) != sizeof(_codec)) {
+        fprintf(stderr, "Corrupt trace `%s'\n", traceFileName.c_str());
+        exit(1);
+      }
+
+      Chunk chunk;
+      while (pread(_fd, &chunk.header, sizeof(ChunkHeader), offset) ==
+             sizeof(ChunkHeader)) {
+        chunk.offset = offset;
+        _chunks.push_back(chunk);
+        offset += sizeof(ChunkHeader) + chunk.header.compressedSize;
+      }
+
+      // decompress up to a few chunks ahead of the current one
+      _slots.resize(min(TraceThreadPool().Threads(), 3U) + 1);
+      for (uint32 i = 0; i < _slots.size(); i ++) {
+        _slots[i].fd = _fd;
+        _slots[i].codec = _codec;
+        _slots[i].pending = false;
+      }
+      Seek(0);
+    }
+
+    ~ChunkedTraceInput() {
+      Drain();
+      close(_fd);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to fill an index with a seek point per chunk
+    // -------------------------------------------------------------------------
+
+    void Index(TraceIndex &index) {
+      uint64 record = 0;
+      index.points.clear();
+      index.firstIcount = 0;
+      if (!_chunks.empty())
+        index.firstIcount = _chunks[0].header.firstIcount;
+      for (uint32 i = 0; i < _chunks.size(); i ++) {
+        TraceIndex::SeekPoint point;
+        point.record = record;
+        point.icount = _chunks[i].header.firstIcount;
+        point.offset = _chunks[i].offset;
+        index.points.push_back(point);
+        record += _chunks[i].header.records;
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to continue reading at the chunk at a byte offset (0 for the
+    // first chunk)
+    // -------------------------------------------------------------------------
+
+    void Seek(uint64 offset) {
+      Drain();
+      _current = 0;
+      while (_current + 1 < _chunks.size() &&
+             _chunks[_current + 1].offset <= offset)
+        _current ++;
+      _ready = false;
+      _position = 0;
+      for (uint32 i = 0; i < _slots.size(); i ++)
+        Schedule(_current + i);
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read the next record. Returns false at the end of the trace
+    // -------------------------------------------------------------------------
+
+    bool Next(TraceRecord &record) {
+      while (true) {
+        if (_current >= _chunks.size())
+          return false;
+
+        DecompressJob &job = _slots[_current % _slots.size()];
+        if (!_ready) {
+          TraceThreadPool().Wait(&job);
+          job.pending = false;
+          if (!job.ok) {
+            fprintf(stderr, "Corrupt chunk %u in trace `%s'\n", _current,
+                    _traceFileName.c_str());
+            exit(1);
+          }
+          _ready = true;
+          _position = 0;
+        }
+
+        if (_position < job.records.size()) {
+          record = job.records[_position ++];
+          return true;
+        }
+
+        // the chunk is consumed. its slot takes the next chunk not yet
+        // scheduled
+        _ready = false;
+        _current ++;
+        Schedule(_current + _slots.size() - 1);
+      }
+    }
+};
+
+#endif // __TRACE_INDEX_H__
@@ -0,0 +1,105 @@
+// -----------------------------------------------------------------------------
+// File: TraceIndexer.cc
+// Description:
+//    Rewrites a trace as a chunked trace with an index, so that the trace
+//    reader can seek in it (see TraceIndex.h). The input can be any trace
+//    the reader takes, so this also converts between codecs and between
+//    text and columnar records (see TraceColumns.h).
+//
+//    Usage: TraceIndexer <input trace> <output trace> [records per chunk]
+//                        [codec] [threads] [text|columnar]
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// Module includes
+// -----------------------------------------------------------------------------
+
+#include "TraceIndex.h"
+
+
+// -----------------------------------------------------------------------------
+// Standard includes
+// -----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+
+// -----------------------------------------------------------------------------
+// Function: main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <input trace> <output trace> "
+            "[records per chunk] [codec] [threads] [text|columnar]\n",
+            argv[0]);
+    return 1;
+  }
+
+  uint32 chunkRecords = TRACE_CHUNK_RECORDS;
+  if (argc > 3)
+    chunkRecords = atoi(argv[3]);
+
+  int32 codec = TRACE_CODEC_GZIP;
+  if (argc > 4) {
+    codec = TraceCodecFromName(argv[4]);
+    if (codec < 0) {
+      fprintf(stderr, "Unknown trace codec `%s'\n", argv[4]);
+      return 1;
+    }
+  }
+
+  if (argc > 5)
+    TraceThreadPool().Start(atoi(argv[5]));
+
+  uint32 layout = TRACE_LAYOUT_TEXT;
+  if (argc > 6) {
+    if (string(argv[6]) == "columnar") {
+      layout = TRACE_LAYOUT_COLUMNAR;
+    }
+    else if (string(argv[6]) != "text") {
+      fprintf(stderr, "Unknown trace format `%s'\n", argv[6]);
+      return 1;
+    }
+  }
+
+  ChunkedTraceInput *chunked = NULL;
+  gzFile input = Z_NULL;
+  if (ChunkedTraceInput::Detect(argv[1])) {
+    chunked = new ChunkedTraceInput(argv[1]);
+  }
+  else {
+    input = gzopen64(argv[1], "r");
+    if (input == Z_NULL) {
+      fprintf(stderr, "Cannot read trace `%s'\n", argv[1]);
+      return 1;
+    }
+  }
+
+  ChunkedTraceWriter output(argv[2], chunkRecords, codec, layout);
+
+  char line[300];
+  if (chunked != NULL) {
+    TraceRecord record;
+    while (chunked -> Next(record))
+      output.Write(record);
+    delete chunked;
+  }
+  else {
+    while (gzgets(input, line, 300) != Z_NULL)
+      output.Write(line);
+    gzclose(input);
+  }
+  output.Close();
+
+  fprintf(stderr, "%llu records\n", output.Records());
+  if (output.Skipped() > 0)
+    fprintf(stderr, "%llu lines skipped (not records)\n", output.Skipped());
+  return 0;
+}
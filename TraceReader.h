@@ -2,6 +2,19 @@
 // File: TraceReader.h
 // Description:
 //    Defines a reader for trace files. It can handle trace I generated.
+//    Each line is "icount ip vaddr paddr size type". An optional seventh
+//    field gives the distance (in trace records) back to the request that
+//    produces this request's address, 0 if independent.
+//
+//    A slice of the trace can be read instead of the whole of it. The slice
+//    is renumbered to start at instruction 1, and wrap-around returns to its
+//    start. With an index (see TraceIndex.h), the reader seeks to the slice
+//    instead of decompressing the trace up to it.
+//
+//    gzip (or plain text) traces and chunk containers are told apart by
+//    their first bytes. The chunks of a container are decompressed ahead on
+//    the trace thread pool, and hold text lines or columnar records (see
+//    TraceColumns.h).
 // -----------------------------------------------------------------------------
 
 #ifndef __TRACE_READER_H__
@@ -13,6 +26,7 @@
 
 #include "Types.h"
 #include "MemoryRequest.h"
+#include "TraceIndex.h"
 
 // -----------------------------------------------------------------------------
 // Standard includes
@@ -20,8 +34,15 @@
 
 #include <zlib.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <string>
 
+// number of past records a dependency can refer to
+#define TRACE_DEP_HISTORY 256
+
 // -----------------------------------------------------------------------------
 // Class: TraceReader
 // Description:
@@ -46,12 +67,29 @@ class TraceReader {
 
     bool _noTrace;
     gzFile _trace;
+    ChunkedTraceInput *_chunked;
     uint64 _startIcount;
     uint64 _lastIcount;
     uint64 _icountShift;
     uint64 _cycleShift;
     bool _first;
 
+    // icounts of the recent records, to resolve dependency distances
+    uint64 _history[TRACE_DEP_HISTORY];
+    uint64 _records;
+
+    // seek points, if the trace is indexed
+    TraceIndex _index;
+    bool _indexed;
+
+    // slice of the trace (trace icounts). an end of 0 is the end of the trace
+    uint64 _sliceStart;
+    uint64 _sliceEnd;
+
+    // record read ahead while positioning the trace
+    TraceRecord _pending;
+    bool _hasPending;
+
     // -------------------------------------------------------------------------
     // Normalize the address
     // -------------------------------------------------------------------------
@@ -60,6 +98,91 @@ class TraceReader {
       return (val + ((addr_t)(_cpuID) << shift));
     }
 
+
+    // -------------------------------------------------------------------------
+    // Function to (re)open the trace at a byte offset. Any offset other than
+    // 0 must be a seek point of the index
+    // -------------------------------------------------------------------------
+
+    bool Open(uint64 offset) {
+      _hasPending = false;
+      if (_chunked != NULL) {
+        _chunked -> Seek(offset);
+        return true;
+      }
+
+      if (_trace != Z_NULL)
+        gzclose(_trace);
+      _trace = Z_NULL;
+
+      int fd = open(_traceFileName.c_str(), O_RDONLY);
+      if (fd < 0)
+        return false;
+      if (offset != 0)
+        lseek(fd, offset, SEEK_SET);
+      _trace = gzdopen(fd, "r");
+      if (_trace == Z_NULL) {
+        close(fd);
+        return false;
+      }
+      return true;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read a record of the trace
+    // -------------------------------------------------------------------------
+
+    bool Next(TraceRecord &record) {
+      if (_chunked != NULL)
+        return _chunked -> Next(record);
+      char line[300];
+      while (gzgets(_trace, line, 300) != Z_NULL)
+        if (ParseTraceRecord(line, record))
+          return true;
+      return false;
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to position the trace at the first record at or after an
+    // icount of the trace
+    // -------------------------------------------------------------------------
+
+    void Position(uint64 icount) {
+      uint64 offset = 0;
+      if (_indexed && icount > 0)
+        offset = _index.Find(icount).offset;
+      Open(offset);
+
+      if (icount == 0)
+        return;
+      while (Next(_pending)) {
+        if (_pending.icount >= icount) {
+          _hasPending = true;
+          return;
+        }
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read the next record of the slice. Returns false at its end
+    // -------------------------------------------------------------------------
+
+    bool ReadRecord(TraceRecord &record) {
+      if (_hasPending) {
+        _hasPending = false;
+        record = _pending;
+      }
+      else if (!Next(record)) {
+        return false;
+      }
+      if (_sliceEnd != 0 && record.icount >= _sliceEnd)
+        return false;
+      return true;
+    }
+
   public:
 
 
@@ -77,13 +200,62 @@ class TraceReader {
       _cycleShift = 0;
       _noTrace = false;
       _first = true;
+      _records = 0;
+      _sliceStart = 0;
+      _sliceEnd = 0;
+      _hasPending = false;
 
       // open the trace file
-      _trace = gzopen64(_traceFileName.c_str(), "r");
-      if (_trace == Z_NULL) {
-        _noTrace = true;
-        // TODO: Error message
+      _trace = Z_NULL;
+      _chunked = NULL;
+      if (ChunkedTraceInput::Detect(_traceFileName)) {
+        _chunked = new ChunkedTraceInput(_traceFileName);
+        _chunked -> Index(_index);
+        _indexed = !_index.points.empty();
+      }
+      else {
+        if (!Open(0)) {
+          _noTrace = true;
+          // TODO: Error message
+        }
+        _indexed = _index.Read(_traceFileName);
+      }
+    }
+
+
+    // -------------------------------------------------------------------------
+    // Function to read a slice of the trace, from its start-th instruction
+    // up to (not including) its end-th one. An end of 0 reads to the end of
+    // the trace
+    // -------------------------------------------------------------------------
+
+    void Slice(uint64 start, uint64 end = 0) {
+      if (_noTrace)
+        return;
+
+      // icount of the first record
+      uint64 firstIcount = 0;
+      if (_indexed) {
+        firstIcount = _index.firstIcount;
       }
+      else {
+        TraceRecord record;
+        Open(0);
+        if (!Next(record)) {
+          _noTrace = true;
+          return;
+        }
+        firstIcount = record.icount;
+      }
+
+      _sliceStart = firstIcount + (start > 0 ? start - 1 : 0);
+      _sliceEnd = (end > 0 ? firstIcount + end - 1 : 0);
+
+      // the slice is renumbered as a new trace
+      _first = true;
+      _icountShift = 0;
+      _records = 0;
+      Position(_sliceStart);
     }
 
 
@@ -97,34 +269,27 @@ class TraceReader {
       if (_noTrace)
         return NULL;
 
-      char line[300];
-      char *ret;
-
-      // read a line from the trace
-      ret = gzgets(_trace, line, 300);
+      TraceRecord record;
 
       // if there is a valid entry
-      if (ret != Z_NULL) {
+      if (ReadRecord(record)) {
         MemoryRequest *request;
         // create a new request and obtain the details
         request = new MemoryRequest;
 
-        // scan the line and fill the request
-        /* sscanf(line, "%u %llu %llu %llu %llu %llu %u %c",
-            &(request -> cpuID), &(request -> currentCycle), 
-            &(request -> icount), &(request -> ip), &(request -> virtualAddress),
-            &(request -> physicalAddress), &(request -> size), &type); */
-        uint32 type;
-        sscanf(line, "%llu %llu %llu %llu %u %u", &(request -> icount),
-            &(request -> ip), &(request -> virtualAddress), 
-            &(request -> physicalAddress), &(request -> size), 
-            &(type));
-        
+        // fill the request
+        request -> icount = record.icount;
+        request -> ip = record.ip;
+        request -> virtualAddress = record.virtualAddress;
+        request -> physicalAddress = record.physicalAddress;
+        request -> size = record.size;
+        uint32 dep = record.dep;
+
         // make initial updates
         request -> iniType = MemoryRequest::CPU;
         request -> cpuID = _cpuID;
         request -> iniPtr = NULL;
-        request -> type = (MemoryRequest::Type)(type);
+        request -> type = (MemoryRequest::Type)(record.type);
 
         // normalize the addresses
         request -> ip = Normalize(request -> ip);
@@ -151,6 +316,13 @@ class TraceReader {
         }
 
         _lastIcount = request -> icount;
+
+        // resolve the producer of the address
+        if (dep != 0 && dep <= _records && dep < TRACE_DEP_HISTORY)
+          request -> depIcount = _history[(_records - dep) % TRACE_DEP_HISTORY];
+        _history[_records % TRACE_DEP_HISTORY] = request -> icount;
+        _records ++;
+
         return request;
       }
 
@@ -163,9 +335,9 @@ class TraceReader {
       // if trace ended
       else if (_wrapAround) {
         _icountShift = _lastIcount + 1;
-        // close and reopen the file
-        gzclose(_trace);
-        _trace = gzopen64(_traceFileName.c_str(), "r");
+        _records = 0;
+        // seek back to the start of the slice
+        Position(_sliceStart);
         // return the next request
         return NextRequest();
       }